@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#include <common/cpufeature.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+
+/* ID_AA64ISAR0_EL1.Atomic, 0b0010: LSE atomic instructions implemented */
+#define ID_AA64ISAR0_ATOMIC_SHIFT	(20)
+#define ID_AA64ISAR0_ATOMIC_MASK	(0xfUL)
+#define ID_AA64ISAR0_ATOMIC_LSE		(0x2UL)
+
+bool cpu_has_lse_atomics = false;
+
+static bool cpu_supports_lse_atomics(void)
+{
+	u64 isar0;
+
+	asm volatile ("mrs %0, id_aa64isar0_el1":"=r" (isar0));
+	return ((isar0 >> ID_AA64ISAR0_ATOMIC_SHIFT) &
+		ID_AA64ISAR0_ATOMIC_MASK) >= ID_AA64ISAR0_ATOMIC_LSE;
+}
+
+/*
+ * Called by the BSP before the other cores are started. Atomics use the
+ * LL/SC fallback until then.
+ */
+void cpu_features_init(void)
+{
+	cpu_has_lse_atomics = cpu_supports_lse_atomics();
+	kinfo("[ChCore] LSE atomics %s\n",
+	      cpu_has_lse_atomics ? "enabled" : "not supported");
+}
+
+/* The APs must support every feature the BSP enabled */
+void cpu_features_check(void)
+{
+	BUG_ON(cpu_has_lse_atomics && !cpu_supports_lse_atomics());
+}
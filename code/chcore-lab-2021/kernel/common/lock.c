@@ -19,6 +19,131 @@
 #include <common/types.h>
 
 struct lock big_kernel_lock;
+/* CPU holding the big kernel lock through lock_kernel(), -1 if none */
+static volatile int big_kernel_lock_owner = -1;
+
+#ifdef CHCORE_MCS_LOCK
+
+/*
+ * Queued (MCS) spinlock.
+ *
+ * lock->val holds the locked bit and the queue tail (cpuid + 1 of the
+ * last waiter, 0 when nobody waits). A waiter appends its per-CPU node to
+ * the queue and spins on the node only, so each waiter polls its own
+ * cache line. Only the head of the queue polls lock->val.
+ *
+ * The kernel runs with IRQs masked, so a CPU waits for at most one lock at
+ * a time and one node per CPU is enough. The node is no longer referenced
+ * once the lock is taken, so the holder may wait for other locks.
+ */
+#define MCS_LOCKED		(1U)
+#define MCS_TAIL_SHIFT		(16)
+#define MCS_TAIL_MASK		(~0U << MCS_TAIL_SHIFT)
+
+struct mcs_node {
+	struct mcs_node *volatile next;
+	volatile u32 locked;
+} __attribute__ ((aligned(CACHELINE_SZ)));
+
+static struct mcs_node mcs_nodes[PLAT_CPU_NUM];
+
+int lock_init(struct lock *lock)
+{
+	BUG_ON(!lock);
+	lock->val = 0;
+	return 0;
+}
+
+/**
+ * Lock the MCS lock
+ * This function will block until the lock is held
+*/
+void lock(struct lock *lock)
+{
+	struct mcs_node *node, *prev, *next;
+	u32 cpuid, tail, old, val;
+
+	BUG_ON(!lock);
+
+	/* Fast path: free and nobody queued */
+	if (atomic_compare_exchange_32(&lock->val, 0, MCS_LOCKED) == 0)
+		return;
+
+	cpuid = smp_get_cpu_id();
+	node = &mcs_nodes[cpuid];
+	node->next = NULL;
+	node->locked = 0;
+	tail = (cpuid + 1) << MCS_TAIL_SHIFT;
+
+	/* Become the new tail */
+	do {
+		old = lock->val;
+		val = atomic_compare_exchange_32(&lock->val, old,
+						 (old & ~MCS_TAIL_MASK) | tail);
+	} while (val != old);
+
+	/* Link behind the previous tail and wait to become the head */
+	if (old & MCS_TAIL_MASK) {
+		prev = &mcs_nodes[(old >> MCS_TAIL_SHIFT) - 1];
+		prev->next = node;
+		smp_cond_load_acquire_32(&node->locked, VAL != 0);
+	}
+
+	/* Head of the queue: wait for the holder to release the lock */
+	while (true) {
+		old = smp_cond_load_acquire_32(&lock->val,
+					       !(VAL & MCS_LOCKED));
+		if ((old & MCS_TAIL_MASK) == tail) {
+			/* Nobody behind us, take the lock and empty the queue */
+			if (atomic_compare_exchange_32(&lock->val, old,
+						       MCS_LOCKED) == old)
+				return;
+			continue;
+		}
+		if (atomic_compare_exchange_32(&lock->val, old,
+					       old | MCS_LOCKED) == old)
+			break;
+	}
+
+	/* Pass the head of the queue to the successor */
+	next = (struct mcs_node *)smp_cond_load_acquire_64(&node->next,
+							   VAL != 0);
+	stlr_32(&next->locked, 1);
+}
+
+/**
+ * Try to lock the MCS lock
+ * Return 0 if succeed, -1 otherwise
+*/
+int try_lock(struct lock *lock)
+{
+	BUG_ON(!lock);
+	if (atomic_compare_exchange_32(&lock->val, 0, MCS_LOCKED) == 0)
+		return 0;
+	return -1;
+}
+
+/**
+ * Unlock the MCS lock
+*/
+void unlock(struct lock *lock)
+{
+	BUG_ON(!lock);
+	smp_mb();
+	/* The tail may change concurrently, clear the locked bit atomically */
+	atomic_fetch_sub_32(&lock->val, MCS_LOCKED);
+}
+
+/**
+ * Check whether the MCS lock is locked
+ * Return 1 if locked, 0 otherwise
+*/
+int is_locked(struct lock *lock)
+{
+	return (lock->val & MCS_LOCKED) != 0;
+}
+
+#else /* Ticket lock */
 
 int lock_init(struct lock *lock)
 {
@@ -39,20 +164,33 @@ void lock(struct lock *lock)
 
 	BUG_ON(!lock);
 
+	if (cpu_has_lse_atomics) {
+		/* One far atomic add takes the ticket, no LL/SC retries */
+		lockval = atomic_fetch_add_32(&lock->next, 1);
+		smp_cond_load_acquire_32(&lock->owner, VAL == lockval);
+		return;
+	}
+
 	/** 
 	 * The following asm code means:
 	 * 
 	 * lock->next = fetch_and_add(1);
 	 * while(lock->next != lock->owner);
+	 *
+	 * While waiting, ldaxr arms the exclusive monitor on owner and wfe
+	 * sleeps until unlock() writes it.
 	 */
 	asm volatile("       prfm    pstl1strm, %3\n"
 				 "1:     ldaxr   %w0, %3\n"
 				 "       add     %w1, %w0, #0x1\n"
 				 "       stxr    %w2, %w1, %3\n"
 				 "       cbnz    %w2, 1b\n"
-				 "2:     ldar    %w2, %4\n"
+				 "2:     ldaxr   %w2, %4\n"
 				 "       cmp     %w0, %w2\n"
-				 "       b.ne    2b\n"
+				 "       b.eq    3f\n"
+				 "       wfe\n"
+				 "       b       2b\n"
+				 "3:\n"
 				 : "=&r"(lockval), "=&r"(newval),
 				   "=&r"(ret), "+Q"(lock->next)
 				 : "Q"(lock->owner)
@@ -69,6 +207,14 @@ int try_lock(struct lock *lock)
 	u32 lockval = 0, newval = 0, ret = 0, ownerval = 0;
 
 	BUG_ON(!lock);
+	if (cpu_has_lse_atomics) {
+		/* Free iff next == owner: take the next ticket with a CAS */
+		ldar_32(&lock->owner, ownerval);
+		if (atomic_compare_exchange_32(&lock->next, ownerval,
+					       ownerval + 1) == ownerval)
+			return 0;
+		return -1;
+	}
 	asm volatile("       prfm    pstl1strm, %4\n"
 				 "       ldaxr   %w0, %4\n"
 				 "       ldar    %w3, %5\n"
@@ -116,6 +262,8 @@ int is_locked(struct lock *lock)
 	return (lock->owner < lock->next);
 }
 
+#endif /* CHCORE_MCS_LOCK */
+
 /**
  * 	Lab4 - exercise 5
  * 	Initialization of the big kernel lock
@@ -132,6 +280,7 @@ void kernel_lock_init(void)
 void lock_kernel(void)
 {
 	lock(&big_kernel_lock);
+	big_kernel_lock_owner = smp_get_cpu_id();
 }
 
 /**
@@ -140,5 +289,16 @@ void lock_kernel(void)
  */
 void unlock_kernel(void)
 {
+	big_kernel_lock_owner = -1;
 	unlock(&big_kernel_lock);
 }
+
+/*
+ * Whether the current CPU holds the big kernel lock.
+ * Paths which may run with or without it (e.g., page faults) use this
+ * before entering code which needs it.
+ */
+bool kernel_lock_held(void)
+{
+	return big_kernel_lock_owner == smp_get_cpu_id();
+}
@@ -14,6 +14,16 @@
 
 #include <common/types.h>
 
+#ifdef CHCORE_MCS_LOCK
+/*
+ * Queued (MCS) spinlock: the locked bit and the tail of the waiter queue.
+ * Waiters spin on their own per-CPU node, see lock.c.
+ */
+struct lock {
+	volatile u32 val;
+	char pad0[pad_to_cache_line(sizeof(u32))];
+} __attribute__ ((aligned(CACHELINE_SZ)));
+#else
 struct lock {
 	volatile u32 owner;		/* 现在持有锁的人 */
 	char pad0[pad_to_cache_line(sizeof(u32))];
@@ -21,6 +31,7 @@ struct lock {
 	volatile u32 next;		/* 下一个需要分发的序号 */
 	char pad1[pad_to_cache_line(sizeof(u32))];
 } __attribute__ ((aligned(CACHELINE_SZ)));
+#endif
 
 int lock_init(struct lock *lock);
 void lock(struct lock *lock);
@@ -33,3 +44,4 @@ extern struct lock big_kernel_lock;
 void kernel_lock_init(void);
 void lock_kernel(void);
 void unlock_kernel(void);
+bool kernel_lock_held(void);
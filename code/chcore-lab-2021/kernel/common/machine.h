@@ -31,3 +31,23 @@
 #define CORE1_IRQ	(IRQ_BASE + 0x4)
 #define CORE2_IRQ	(IRQ_BASE + 0x8)
 #define CORE3_IRQ	(IRQ_BASE + 0xc)
+
+// Local mailbox interrupt control registers
+#define MBOX_IRQCNTL_BASE	(KBASE + 0x40000050)
+#define CORE0_MBOX_IRQCNTL	(MBOX_IRQCNTL_BASE + 0x0)
+#define CORE1_MBOX_IRQCNTL	(MBOX_IRQCNTL_BASE + 0x4)
+#define CORE2_MBOX_IRQCNTL	(MBOX_IRQCNTL_BASE + 0x8)
+#define CORE3_MBOX_IRQCNTL	(MBOX_IRQCNTL_BASE + 0xc)
+#define INT_SRC_MBOX0		0x010
+
+// Mailbox 0 of each core: write to set bits, read and write back to clear
+#define MBOX_SET_BASE		(KBASE + 0x40000080)
+#define CORE0_MBOX0_SET		(MBOX_SET_BASE + 0x00)
+#define CORE1_MBOX0_SET		(MBOX_SET_BASE + 0x10)
+#define CORE2_MBOX0_SET		(MBOX_SET_BASE + 0x20)
+#define CORE3_MBOX0_SET		(MBOX_SET_BASE + 0x30)
+#define MBOX_CLR_BASE		(KBASE + 0x400000c0)
+#define CORE0_MBOX0_CLR		(MBOX_CLR_BASE + 0x00)
+#define CORE1_MBOX0_CLR		(MBOX_CLR_BASE + 0x10)
+#define CORE2_MBOX0_CLR		(MBOX_CLR_BASE + 0x20)
+#define CORE3_MBOX0_CLR		(MBOX_CLR_BASE + 0x30)
@@ -156,6 +156,7 @@ static void radix_free_node(struct radix_node *node, int node_level,
 						node_level + 1, value_deleter);
 		}
 	}
+	kfree(node);
 }
 
 int radix_free(struct radix *radix)
@@ -166,6 +167,7 @@ int radix_free(struct radix *radix)
 	}
 	// recurssively free nodes and values (if value_deleter is not NULL)
 	radix_free_node(radix->root, 0, radix->value_deleter);
+	radix->root = NULL;
 
 	return 0;
 }
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#include <common/rwlock.h>
+#include <common/sync.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+
+/*
+ * rwlock->cnts layout:
+ * [7:0]  a writer holds the lock
+ * [8]    a writer waits for the readers to leave
+ * [31:9] number of readers
+ */
+#define RW_WLOCKED	(0xffU)
+#define RW_WWAITING	(0x100U)
+#define RW_WMASK	(RW_WLOCKED | RW_WWAITING)
+#define RW_RBIAS	(0x200U)
+
+int rwlock_init(struct rwlock *rwlock)
+{
+	BUG_ON(!rwlock);
+	rwlock->cnts = 0;
+	return lock_init(&rwlock->wait_lock);
+}
+
+void read_lock(struct rwlock *rwlock)
+{
+	u32 cnts;
+
+	/* Fast path: no writer holds or waits for the lock */
+	cnts = atomic_fetch_add_32(&rwlock->cnts, RW_RBIAS);
+	if (likely(!(cnts & RW_WMASK)))
+		return;
+
+	/* Back off and queue up behind the writer */
+	atomic_fetch_sub_32(&rwlock->cnts, RW_RBIAS);
+	lock(&rwlock->wait_lock);
+	atomic_fetch_add_32(&rwlock->cnts, RW_RBIAS);
+	/* Waiting writers are queued behind us, only wait for the holder */
+	smp_cond_load_acquire_32(&rwlock->cnts, !(VAL & RW_WLOCKED));
+	unlock(&rwlock->wait_lock);
+}
+
+/* Return 0 if succeed, -1 otherwise */
+int read_try_lock(struct rwlock *rwlock)
+{
+	u32 cnts;
+
+	cnts = rwlock->cnts;
+	if (cnts & RW_WMASK)
+		return -1;
+	if (atomic_compare_exchange_32(&rwlock->cnts, cnts, cnts + RW_RBIAS)
+	    != cnts)
+		return -1;
+	return 0;
+}
+
+void read_unlock(struct rwlock *rwlock)
+{
+	smp_mb();
+	atomic_fetch_sub_32(&rwlock->cnts, RW_RBIAS);
+}
+
+void write_lock(struct rwlock *rwlock)
+{
+	u32 cnts;
+
+	/* Fast path: nobody holds the lock */
+	if (likely(atomic_compare_exchange_32(&rwlock->cnts, 0, RW_WLOCKED)
+		   == 0))
+		return;
+
+	lock(&rwlock->wait_lock);
+	/* Stop new readers from taking the fast path */
+	do {
+		cnts = rwlock->cnts;
+	} while (atomic_compare_exchange_32(&rwlock->cnts, cnts,
+					    cnts | RW_WWAITING) != cnts);
+	/* Wait for the readers (and a fast-path writer) to leave */
+	do {
+		smp_cond_load_acquire_32(&rwlock->cnts, VAL == RW_WWAITING);
+	} while (atomic_compare_exchange_32(&rwlock->cnts, RW_WWAITING,
+					    RW_WLOCKED) != RW_WWAITING);
+	unlock(&rwlock->wait_lock);
+}
+
+/* Return 0 if succeed, -1 otherwise */
+int write_try_lock(struct rwlock *rwlock)
+{
+	if (atomic_compare_exchange_32(&rwlock->cnts, 0, RW_WLOCKED) != 0)
+		return -1;
+	return 0;
+}
+
+void write_unlock(struct rwlock *rwlock)
+{
+	smp_mb();
+	atomic_fetch_sub_32(&rwlock->cnts, RW_WLOCKED);
+}
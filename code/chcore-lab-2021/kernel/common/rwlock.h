@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#pragma once
+
+#include <common/types.h>
+#include <common/lock.h>
+#include <common/sync.h>
+
+/*
+ * Fair reader-writer spinlock.
+ * Readers only do one atomic add when no writer is around. Once a writer
+ * waits, new readers queue up on wait_lock behind it, so writers are not
+ * starved.
+ */
+struct rwlock {
+	volatile u32 cnts;
+	struct lock wait_lock;
+};
+
+int rwlock_init(struct rwlock *rwlock);
+void read_lock(struct rwlock *rwlock);
+int read_try_lock(struct rwlock *rwlock);
+void read_unlock(struct rwlock *rwlock);
+void write_lock(struct rwlock *rwlock);
+int write_try_lock(struct rwlock *rwlock);
+void write_unlock(struct rwlock *rwlock);
+
+/*
+ * Sequence lock.
+ * Writers are serialized by the lock and make the sequence odd while
+ * updating. Readers never write shared memory: they retry when the
+ * sequence was odd or changed. Readers must only copy plain data out,
+ * never follow pointers which a writer may free.
+ *
+ * do {
+ *	seq = read_seqbegin(&sl);
+ *	... copy the data ...
+ * } while (read_seqretry(&sl, seq));
+ */
+struct seqlock {
+	volatile u32 sequence;
+	struct lock lock;
+};
+
+static inline void seqlock_init(struct seqlock *sl)
+{
+	sl->sequence = 0;
+	lock_init(&sl->lock);
+}
+
+static inline void write_seqlock(struct seqlock *sl)
+{
+	lock(&sl->lock);
+	sl->sequence++;
+	smp_wmb();
+}
+
+static inline void write_sequnlock(struct seqlock *sl)
+{
+	smp_wmb();
+	sl->sequence++;
+	unlock(&sl->lock);
+}
+
+static inline u32 read_seqbegin(struct seqlock *sl)
+{
+	/* Sleep in wfe while a writer is inside */
+	return smp_cond_load_acquire_32(&sl->sequence, !(VAL & 1));
+}
+
+static inline bool read_seqretry(struct seqlock *sl, u32 start)
+{
+	smp_rmb();
+	return sl->sequence != start;
+}
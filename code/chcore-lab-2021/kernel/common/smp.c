@@ -15,12 +15,27 @@
 #include <common/types.h>
 #include <common/vars.h>
 #include <common/mm.h>
+#include <common/sync.h>
 
 #define NOT_BSS (0xBEEFUL)
 volatile char cpu_status[PLAT_CPU_NUM] = { cpu_hang, cpu_hang, cpu_hang,
 	cpu_hang
 };
 
+struct per_cpu_info cpu_info[PLAT_CPU_NUM];
+
+/*
+ * Called first thing on each CPU: nothing using smp_get_cpu_id (e.g. the
+ * MCS lock) may run before. The rest of the block is set up by its users.
+ */
+void init_per_cpu_info(u32 cpuid)
+{
+	struct per_cpu_info *info = &cpu_info[cpuid];
+
+	info->cpu_id = cpuid;
+	asm volatile ("msr tpidr_el1, %0"::"r" (info));
+}
+
 /* 
  * Other cores are busy looping on the addr, wake up those cores 
  * addr 就secondary的地址
@@ -40,6 +55,9 @@ void enable_smp_cores(void *addr)
 		 * You only need to write one line of code.
 		 */
 		secondary_boot_flag[i] =  NOT_BSS ;
+		/* The APs wait in wfe in start.S, wake them up */
+		dsb(sy);
+		sev();
 
 		/* Lab4 - exercise2
 		 * 把 secondary_boot_flag 改为不等于0后
@@ -52,20 +70,10 @@ void enable_smp_cores(void *addr)
 		 * The BSP waits for the currently initializing AP finishing
 		 * before activating the next one
 		 */
-		while(cpu_status[i] != cpu_run){
-			; //wait
-		}
+		smp_cond_load_acquire_8(&cpu_status[i], VAL == cpu_run);
 	}
 
 	/* This information is printed when all CPUs finish their initialization */
 	kinfo("All %d CPUs are active\n", PLAT_CPU_NUM);
 }
 
-
-u32 smp_get_cpu_id(void)
-{
-	u64 cpuid = 0;
-
-	asm volatile ("mrs %0, tpidr_el1":"=r" (cpuid));
-	return (u32) cpuid;
-}
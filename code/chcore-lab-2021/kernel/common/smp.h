@@ -15,6 +15,11 @@
 #include <common/vars.h>
 #include <common/machine.h>
 #include <common/types.h>
+#include <common/list.h>
+#include <common/lock.h>
+#include <mm/kstack.h>
+
+struct thread;
 
 enum cpu_state {
 	cpu_hang = 0,
@@ -24,5 +29,53 @@ enum cpu_state {
 
 extern volatile char cpu_status[PLAT_CPU_NUM];
 
+/*
+ * Data used by one CPU only (or mostly), TPIDR_EL1 holds the address of
+ * the block of the current CPU. Each block starts on its own cache line.
+ */
+struct per_cpu_info {
+	/* Logical cpuid, must stay first: read by the stack overflow entry */
+	u32 cpu_id;
+	/* Thread running on this CPU */
+	struct thread *cur_thread;
+	struct thread *idle_thread;
+	/*
+	 * Thread whose FP/SIMD state is in the registers of this CPU, and
+	 * whether it may have changed them since (EL0 access enabled).
+	 */
+	struct thread *fpu_owner;
+	bool fpu_enabled;
+
+	/* Statistics: the thread last switched in and whether it is freed */
+	struct thread *last_thread;
+	bool last_exited;
+
+	/* Kernel stacks freed on this CPU, see mm/kstack.c */
+	void *kstack_cache[KSTACK_CACHE_NUM];
+	u32 kstack_cache_nr;
+
+	/*
+	 * Ready queue of the round robin policy. Other CPUs enqueue here,
+	 * so the lock and the queue get their own cache lines.
+	 */
+	struct lock rr_ready_queue_lock;
+	struct list_head rr_ready_queue;
+} __attribute__ ((aligned(CACHELINE_SZ)));
+
+extern struct per_cpu_info cpu_info[PLAT_CPU_NUM];
+
+void init_per_cpu_info(u32 cpuid);
 void enable_smp_cores(void *addr);
-u32 smp_get_cpu_id(void);
+
+static inline struct per_cpu_info *get_per_cpu_info(void)
+{
+	struct per_cpu_info *info;
+
+	asm volatile ("mrs %0, tpidr_el1":"=r" (info));
+	return info;
+}
+
+static inline u32 smp_get_cpu_id(void)
+{
+	return get_per_cpu_info()->cpu_id;
+}
@@ -13,6 +13,7 @@
 #pragma once
 
 #include <common/types.h>
+#include <common/cpufeature.h>
 
 #define COMPILER_BARRIER() asm volatile("":::"memory")
 
@@ -41,18 +42,70 @@
 #define ldar_64(ptr, value) asm volatile("ldar %x0, [%1]" : "=r" (value) : "r" (ptr))
 #define stlr_64(ptr, value) asm volatile("stlr %x0, [%1]" : : "rZ" (value) , "r" (ptr))
 
+/*
+ * Load-acquire exclusive. Besides the load it arms the exclusive monitor,
+ * so the next store to *ptr by another CPU clears it and generates an
+ * event which wakes up a following wfe.
+ */
+#define ldaxr_8(ptr, value)  asm volatile("ldaxrb %w0, [%1]" : "=r" (value) : "r" (ptr) : "memory")
+#define ldaxr_32(ptr, value) asm volatile("ldaxr %w0, [%1]" : "=r" (value) : "r" (ptr) : "memory")
+#define ldaxr_64(ptr, value) asm volatile("ldaxr %x0, [%1]" : "=r" (value) : "r" (ptr) : "memory")
+
+/*
+ * Wait until `cond_expr` holds and return the value of *ptr which
+ * satisfied it. `cond_expr` refers to that value as VAL.
+ * Instead of polling, the CPU sleeps in wfe until *ptr is written (or
+ * any other event arrives), see ldaxr_*.
+ */
+#define __smp_cond_load_acquire(ptr, cond_expr, len)			\
+({									\
+	u##len VAL;							\
+	for (;;) {							\
+		ldaxr_##len(ptr, VAL);					\
+		if (cond_expr)						\
+			break;						\
+		wfe();							\
+	}								\
+	VAL;								\
+})
+
+#define smp_cond_load_acquire_8(ptr, cond_expr) \
+	__smp_cond_load_acquire(ptr, cond_expr, 8)
+#define smp_cond_load_acquire_32(ptr, cond_expr) \
+	__smp_cond_load_acquire(ptr, cond_expr, 32)
+#define smp_cond_load_acquire_64(ptr, cond_expr) \
+	__smp_cond_load_acquire(ptr, cond_expr, 64)
+
+/*
+ * Every atomic below has two implementations: ARMv8.1 LSE instructions
+ * (CAS/LDADD/LDSET/SWP), which are a single far atomic even under
+ * contention, and an LL/SC loop for older cores. cpu_has_lse_atomics is
+ * set at boot from ID_AA64ISAR0_EL1 and only read afterwards, so the branch
+ * is well predicted. It stays false (LL/SC) until then.
+ */
+#define __LSE_PREAMBLE	".arch_extension lse\n"
+
 #define __atomic_compare_exchange(ptr, compare, exchange, len, width)	\
 ({									\
 	u##len oldval;							\
 	u32 ret;							\
-	asm volatile ("1: ldaxr   %"#width"0, %2\n"			\
-		      "   cmp     %"#width"0, %"#width"3\n"		\
-		      "   b.ne    2f\n"					\
-		      "   stlxr   %w1, %"#width"4, %2\n"		\
-		      "   cbnz    %w1, 1b\n"				\
-		      "2:":"=&r" (oldval), "=&r"(ret), "+Q"(*ptr)	\
-		      :"r"(compare), "r"(exchange)			\
-	    );								\
+	if (cpu_has_lse_atomics) {					\
+		oldval = (u##len)(compare);				\
+		asm volatile (__LSE_PREAMBLE				\
+			      "   casal   %"#width"0, %"#width"2, %1\n"	\
+			      :"+r" (oldval), "+Q"(*ptr)		\
+			      :"r"(exchange)				\
+			      :"memory");				\
+	} else {							\
+		asm volatile ("1: ldaxr   %"#width"0, %2\n"		\
+			      "   cmp     %"#width"0, %"#width"3\n"	\
+			      "   b.ne    2f\n"				\
+			      "   stlxr   %w1, %"#width"4, %2\n"	\
+			      "   cbnz    %w1, 1b\n"			\
+			      "2:":"=&r" (oldval), "=&r"(ret), "+Q"(*ptr) \
+			      :"r"(compare), "r"(exchange)		\
+			      :"memory");				\
+	}								\
 	oldval;								\
 })
 
@@ -65,32 +118,58 @@ static inline s64 atomic_exchange_64(s64 * ptr, s64 exchange)
 {
 	s64 oldval;
 	s32 ret;
+
+	if (cpu_has_lse_atomics) {
+		asm volatile (__LSE_PREAMBLE
+			      "   swpal   %x2, %x0, %1\n"
+			      :"=r" (oldval), "+Q"(*ptr)
+			      :"r"(exchange)
+			      :"memory");
+		return oldval;
+	}
 	asm volatile ("1: ldaxr   %x0, %2\n"
 		      "   stlxr   %w1, %x3, %2\n"
 		      "   cbnz    %w1, 1b\n"
 		      "2:":"=&r" (oldval), "=&r"(ret), "+Q"(*ptr)
 		      :"r"(exchange)
-	    );
+		      :"memory");
 	return oldval;
 }
 
-#define __atomic_fetch_op(ptr, val, len, width, op)			\
+/*
+ * `op` is the ALU instruction of the LL/SC loop, `lse_op` the LSE
+ * instruction applying `lse_val` (e.g., sub is ldadd of the negation).
+ */
+#define __atomic_fetch_op(ptr, val, len, width, op, lse_op, lse_val)	\
 ({									\
 	u##len oldval, newval;						\
 	u32 ret;							\
-	asm volatile ("1: ldaxr   %"#width"0, %3\n"			\
-		      "   "#op"   %"#width"1, %"#width"0, %"#width"4\n"	\
-		      "   stlxr   %w2, %"#width"1, %3\n"		\
-		      "   cbnz    %w2, 1b\n"				\
-		      "2:":"=&r" (oldval), "=&r"(newval),		\
-		      "=&r"(ret), "+Q"(*ptr)				\
-		      :"r"(val)						\
-	    );								\
+	if (cpu_has_lse_atomics) {					\
+		asm volatile (__LSE_PREAMBLE				\
+			      "   "#lse_op" %"#width"2, %"#width"0, %1\n" \
+			      :"=r" (oldval), "+Q"(*ptr)		\
+			      :"r"((u##len)(lse_val))			\
+			      :"memory");				\
+	} else {							\
+		asm volatile ("1: ldaxr   %"#width"0, %3\n"		\
+			      "   "#op"   %"#width"1, %"#width"0, %"#width"4\n" \
+			      "   stlxr   %w2, %"#width"1, %3\n"	\
+			      "   cbnz    %w2, 1b\n"			\
+			      "2:":"=&r" (oldval), "=&r"(newval),	\
+			      "=&r"(ret), "+Q"(*ptr)			\
+			      :"r"(val)					\
+			      :"memory");				\
+	}								\
 	oldval;								\
  })
 
-#define atomic_fetch_sub_32(ptr, val) __atomic_fetch_op(ptr, val, 32, w, sub)
-#define atomic_fetch_sub_64(ptr, val) __atomic_fetch_op(ptr, val, 64, x, sub)
-#define atomic_fetch_add_32(ptr, val) __atomic_fetch_op(ptr, val, 32, w, add)
-#define atomic_fetch_add_64(ptr, val) __atomic_fetch_op(ptr, val, 64, x, add)
-#define atomic_set_bit_32(ptr, val)   __atomic_fetch_op(ptr, 1<<(val), 32, w, or)
+#define atomic_fetch_sub_32(ptr, val) \
+	__atomic_fetch_op(ptr, val, 32, w, sub, ldaddal, -(val))
+#define atomic_fetch_sub_64(ptr, val) \
+	__atomic_fetch_op(ptr, val, 64, x, sub, ldaddal, -(val))
+#define atomic_fetch_add_32(ptr, val) \
+	__atomic_fetch_op(ptr, val, 32, w, add, ldaddal, val)
+#define atomic_fetch_add_64(ptr, val) \
+	__atomic_fetch_op(ptr, val, 64, x, add, ldaddal, val)
+#define atomic_set_bit_32(ptr, val) \
+	__atomic_fetch_op(ptr, 1<<(val), 32, w, orr, ldsetal, 1<<(val))
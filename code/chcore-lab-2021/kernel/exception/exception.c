@@ -19,8 +19,10 @@
 #include <common/types.h>
 #include <common/util.h>
 #include <exception/irq.h>
+#include <exception/ipi.h>
 #include <exception/pgfault.h>
 #include <sched/sched.h>
+#include <sched/fpu.h>
 
 u8 irq_handle_type[MAX_IRQ_NUM];
 
@@ -33,6 +35,8 @@ void exception_init_per_cpu(void)
 	 * shceduling
 	 */
 	timer_init();
+	ipi_init();
+	fpu_init();
 
 	/**
 	 * Lab3: Your code here
@@ -65,13 +69,17 @@ void handle_entry_c(int type, u64 esr, u64 address)
 	 */
 	/*
 	 * 是不是内核态 看type
+	 * Page faults from user mode only need the lock of the faulting
+	 * vmspace, so they run without the big kernel lock.
 	 */
-	if(type >= SYNC_EL0_64){ 
-		lock_kernel();
-	}
-
 	/* ec: exception class */
 	u32 esr_ec = GET_ESR_EL1_EC(esr);
+	bool locked = false;
+
+	if (type >= SYNC_EL0_64 && esr_ec != ESR_EL1_EC_DABT_LEL) {
+		lock_kernel();
+		locked = true;
+	}
 
 	kdebug("Interrupt type: %d, ESR: 0x%lx, Fault address: 0x%lx, EC 0b%lx\n",
 		   type, esr, address, esr_ec);
@@ -98,8 +106,17 @@ void handle_entry_c(int type, u64 esr, u64 address)
 		do_page_fault(esr, address);
 		break;
 
+	case ESR_EL1_EC_ENFP:
+		/* The kernel is built without FP/SIMD */
+		BUG_ON(type < SYNC_EL0_64);
+		fpu_handle_trap();
+		break;
+
 	default:
 		kdebug("Unsupported Exception ESR %lx\n", esr);
 		break;
 	}
+
+	if (locked)
+		unlock_kernel();
 }
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+#include <common/kprint.h>
+#include <common/lock.h>
+#include <common/machine.h>
+#include <common/macro.h>
+#include <common/errno.h>
+#include <common/smp.h>
+#include <common/sync.h>
+#include <common/tools.h>
+#include <common/types.h>
+#include <exception/ipi.h>
+
+/* in mm/page_table.S */
+extern void flush_tlb_local(void);
+
+/* Per core mailbox MMIO address */
+u64 core_mbox_irqcntl[PLAT_CPU_NUM] = {
+	CORE0_MBOX_IRQCNTL, CORE1_MBOX_IRQCNTL, CORE2_MBOX_IRQCNTL,
+	CORE3_MBOX_IRQCNTL
+};
+
+u64 core_mbox_set[PLAT_CPU_NUM] = {
+	CORE0_MBOX0_SET, CORE1_MBOX0_SET, CORE2_MBOX0_SET, CORE3_MBOX0_SET
+};
+
+u64 core_mbox_clr[PLAT_CPU_NUM] = {
+	CORE0_MBOX0_CLR, CORE1_MBOX0_CLR, CORE2_MBOX0_CLR, CORE3_MBOX0_CLR
+};
+
+/*
+ * Messages waiting for one target CPU. The senders fill in the request and
+ * bump a sequence number, the target reports the latest sequence number it
+ * has served.
+ */
+struct ipi_data {
+	/* Serializes function calls to this CPU, a zeroed lock is free */
+	struct lock call_lock;
+	ipi_func_t call_func;
+	void *call_arg;
+	volatile u64 call_posted;
+	volatile u64 call_taken;
+	volatile u64 call_done;
+
+	volatile u64 tlb_req;
+	volatile u64 tlb_done;
+} __attribute__ ((aligned(CACHELINE_SZ)));
+
+static struct ipi_data ipi_data[PLAT_CPU_NUM];
+
+void ipi_init(void)
+{
+	/* Route mailbox 0 of the current core to its IRQ */
+	put32(core_mbox_irqcntl[smp_get_cpu_id()], 1);
+}
+
+void ipi_send(u32 cpuid, enum ipi_type type)
+{
+	BUG_ON(cpuid >= PLAT_CPU_NUM || type >= IPI_TYPE_NUM);
+
+	/* The message must be visible before the target takes the IRQ */
+	dsb(sy);
+	put32(core_mbox_set[cpuid], 1 << type);
+}
+
+static void ipi_handle_call(struct ipi_data *data)
+{
+	ipi_func_t func;
+	void *arg;
+	u64 seq;
+
+	seq = data->call_posted;
+	if (seq == data->call_taken)
+		return;
+	smp_mb();
+
+	func = data->call_func;
+	arg = data->call_arg;
+	/* The slot can be reused by the next caller from now on */
+	smp_mb();
+	data->call_taken = seq;
+
+	func(arg);
+
+	smp_mb();
+	data->call_done = seq;
+}
+
+static void ipi_handle_tlb_shootdown(struct ipi_data *data)
+{
+	u64 req;
+
+	/* One flush serves every request posted so far */
+	req = data->tlb_req;
+	smp_mb();
+	flush_tlb_local();
+	smp_mb();
+	data->tlb_done = req;
+}
+
+static void ipi_handle(u32 pending_mask)
+{
+	u32 cpuid = smp_get_cpu_id();
+	struct ipi_data *data = &ipi_data[cpuid];
+	u32 pending;
+
+	pending = get32(core_mbox_clr[cpuid]) & pending_mask;
+	if (pending == 0)
+		return;
+	/* Clear first, so a message posted from now on raises the bit again */
+	put32(core_mbox_clr[cpuid], pending);
+	dsb(sy);
+
+	if (pending & (1 << IPI_CALL))
+		ipi_handle_call(data);
+	if (pending & (1 << IPI_TLB_SHOOTDOWN))
+		ipi_handle_tlb_shootdown(data);
+	/*
+	 * Nothing to do for IPI_RESCHED: handle_irq always calls sched()
+	 * after handling the interrupt.
+	 */
+}
+
+/* Called from the IRQ handler */
+void plat_handle_ipi(void)
+{
+	ipi_handle((1 << IPI_TYPE_NUM) - 1);
+}
+
+/*
+ * Serve pending calls and shootdowns while spinning with IRQs masked, so
+ * that two CPUs waiting for each other make progress. A reschedule request
+ * is left pending and taken as an IRQ once we return to the thread.
+ */
+void ipi_poll(void)
+{
+	ipi_handle(((1 << IPI_TYPE_NUM) - 1) & ~(1 << IPI_RESCHED));
+}
+
+/*
+ * Run `func(arg)` on CPU `cpuid` and, if `wait` is set, return once it has
+ * finished. The target runs it in its IRQ handler without the big kernel
+ * lock, so the caller must not wait while holding the big kernel lock.
+ */
+int smp_call_function(u32 cpuid, ipi_func_t func, void *arg, bool wait)
+{
+	struct ipi_data *data;
+	u64 seq;
+
+	if (cpuid >= PLAT_CPU_NUM || func == NULL)
+		return -EINVAL;
+
+	if (cpuid == smp_get_cpu_id()) {
+		func(arg);
+		return 0;
+	}
+
+	data = &ipi_data[cpuid];
+	while (try_lock(&data->call_lock) != 0)
+		ipi_poll();
+
+	seq = data->call_posted + 1;
+	data->call_func = func;
+	data->call_arg = arg;
+	smp_mb();
+	data->call_posted = seq;
+	ipi_send(cpuid, IPI_CALL);
+
+	/* Wait until the target has read the slot before releasing it */
+	while (data->call_taken != seq)
+		ipi_poll();
+	unlock(&data->call_lock);
+
+	if (wait) {
+		while (data->call_done < seq)
+			ipi_poll();
+		smp_mb();
+	}
+	return 0;
+}
+
+/*
+ * Flush the local TLB of every CPU in `cpu_mask` and wait for all of them.
+ * flush_tlb already broadcasts to the inner shareable domain; this is for
+ * invalidations which have to happen on the target core itself.
+ */
+void tlb_shootdown(u64 cpu_mask)
+{
+	u64 gen[PLAT_CPU_NUM] = { 0 };
+	u32 self = smp_get_cpu_id();
+	u32 cpuid;
+
+	for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+		if (!(cpu_mask & (1UL << cpuid)) || cpuid == self)
+			continue;
+		gen[cpuid] = atomic_fetch_add_64(&ipi_data[cpuid].tlb_req, 1) + 1;
+		ipi_send(cpuid, IPI_TLB_SHOOTDOWN);
+	}
+
+	if (cpu_mask & (1UL << self))
+		flush_tlb_local();
+
+	for (cpuid = 0; cpuid < PLAT_CPU_NUM; cpuid++) {
+		while (ipi_data[cpuid].tlb_done < gen[cpuid])
+			ipi_poll();
+	}
+	smp_mb();
+}
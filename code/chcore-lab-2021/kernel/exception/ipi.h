@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#pragma once
+
+#include <common/types.h>
+
+/*
+ * Inter-processor interrupts on the BCM2836 local mailboxes. Every message
+ * type is one bit of mailbox 0 of the target core, so messages of the same
+ * type sent before the target handles them are merged.
+ */
+enum ipi_type {
+	/* Let the target pick up newly enqueued threads */
+	IPI_RESCHED = 0,
+	/* Run the function posted with smp_call_function */
+	IPI_CALL,
+	/* Invalidate the local TLB of the target */
+	IPI_TLB_SHOOTDOWN,
+	IPI_TYPE_NUM
+};
+
+typedef void (*ipi_func_t)(void *arg);
+
+void ipi_init(void);
+void ipi_send(u32 cpuid, enum ipi_type type);
+void plat_handle_ipi(void);
+void ipi_poll(void);
+
+int smp_call_function(u32 cpuid, ipi_func_t func, void *arg, bool wait);
+void tlb_shootdown(u64 cpu_mask);
@@ -11,6 +11,7 @@
  */
 
 #include <exception/irq.h>
+#include <exception/ipi.h>
 #include <exception/timer.h>
 #include <exception/exception.h>
 
@@ -34,6 +35,12 @@ u64 core_irq_source[PLAT_CPU_NUM] = {
 
 void handle_irq(int type)
 {
+	/*
+	 * IPIs are served before taking the big kernel lock: a CPU waiting
+	 * for a function call may be spinning for us with other locks held.
+	 */
+	plat_handle_ipi();
+
 	/**
 	 * Lab4 - exercise 5
 	 * Acquire the big kernel lock, if :
@@ -45,13 +52,9 @@ void handle_irq(int type)
 	}
 
 
+	/* The timer irq charges the budget in handle_timer_irq */
 	plat_handle_irq();
 
-	/**
-	 * Lab4 - exercise 11
-	 * Do you miss something?
-	 */
-	sched_handle_timer_irq();
 	sched();
 	eret_to_thread(switch_context());
 }
@@ -64,12 +67,18 @@ void plat_handle_irq(void)
 
 	cpuid = smp_get_cpu_id();
 	irq_src = get32(core_irq_source[cpuid]);
+	/* The mailbox may already be drained by plat_handle_ipi */
+	if (irq_src == 0)
+		return;
 
 	irq = 1 << ctzl(irq_src);
 	switch (irq) {
 	case INT_SRC_TIMER3:
 		handle_timer_irq();
 		break;
+	case INT_SRC_MBOX0:
+		plat_handle_ipi();
+		break;
 	default:
 		kinfo("Unsupported IRQ %d\n", irq);
 	}
@@ -21,8 +21,10 @@
 #include <common/macro.h>
 #include <common/mm.h>
 #include <common/kmalloc.h>
+#include <common/lock.h>
 
 #include "esr.h"
+#include <mm/page_table.h>
 
 static inline vaddr_t get_fault_addr()
 {
@@ -31,8 +33,6 @@ static inline vaddr_t get_fault_addr()
 	return addr;
 }
 
-int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr);
-
 void do_page_fault(u64 esr, u64 fault_ins_addr)
 {
 	vaddr_t fault_addr;
@@ -52,6 +52,9 @@ void do_page_fault(u64 esr, u64 fault_ins_addr)
 					       fault_addr);
 			if (ret != 0) {
 				kinfo("pgfault at 0x%p failed\n", fault_addr);
+				/* sys_exit needs the big kernel lock */
+				if (!kernel_lock_held())
+					lock_kernel();
 				sys_exit(ret);
 			}
 			break;
@@ -68,7 +71,10 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
 	struct vmregion *vmr;
 	struct pmobject *pmo;
 	paddr_t pa;
-	// u64 offset;
+	pte_t *pte;
+	void *page;
+	u64 index;
+	int ret = -ENOMAPPING;
 
 	/*
 	 * Lab3: your code here
@@ -83,16 +89,22 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
 	 * 
 	 * NOTE: the real physical address of the PMO may not be
 	 * continuous. In real chcore, all the physical pages of a PMO
-	 * are recorded in a radix tree for easy management. Such code
-	 * has been omitted in our lab for simplification.
+	 * are recorded in a radix tree for easy management.
+	 */
+
+	/*
+	 * Page faults run without the big kernel lock. The vmregion stays
+	 * valid while vmr_lock is held for read, and pgtbl_lock serializes
+	 * faults on the same vmspace.
 	 */
+	read_lock(&vmspace->vmr_lock);
 
 	/* 1. Get the vmregion of the fault_addr using find_vmr_for_va */
 	vmr = find_vmr_for_va(vmspace, fault_addr);
 	if (vmr == NULL)
 	{
 		kinfo("[ERROR]: Get the vmregion of the fault_addr failed\n");
-		return -ENOMAPPING;
+		goto out_unlock;
 	}
 
 	/* 2. If the pmo is not of type PMO_ANONYM, return -ENOMAPPING */
@@ -100,41 +112,51 @@ int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr)
 	if (pmo->type != PMO_ANONYM)
 	{
 		kinfo("[ERROR]:  the pmo is not of type PMO_ANONYM\n");
-		return -ENOMAPPING;
+		goto out_unlock;
 	}
 
-	/* 3. Allocate one physical memory page for the PMO */
-	// kdebug("Allocate one physical memory page for the PMO\n");
-	// pa = (paddr_t) virt_to_phys(kmalloc(pmo->size));
-	// pmo -> start = pa;
-
-	// /* 4. Map the allocated address back to the page table */
-	// kdebug("Map the allocated address back to the page table \n");
-	// // if(map_range_in_pgtbl(vmspace->pgtbl, vmr->start, pa, pmo->size, vmr->perm) < 0){
-	// // 	kinfo("[ERROR]:  Map the allocated address back to the page table failed\n");
-	// // 	return -ENOMAPPING;
-	// // }
-	// if(map_range_in_pgtbl(vmspace->pgtbl, fault_addr, pa,PAGE_SIZE, vmr->perm) < 0){
-	// 	return -ENOMAPPING;
-	// }
-
-	void *page = get_pages(0);
-	if (page == NULL)
-	{
-		kinfo("handle_trans_fault get_pages failed\n");
-		return -ENOMAPPING;
+	/* Another thread of the process may have handled the same fault */
+	lock(&vmspace->pgtbl_lock);
+	if (query_in_pgtbl(vmspace->pgtbl, fault_addr, &pa, &pte) == 0) {
+		ret = 0;
+		goto out_unlock_pgtbl;
 	}
-	
-	pa = (paddr_t)virt_to_phys((vaddr_t)page);
 
-	fault_addr = ROUND_DOWN(fault_addr,PAGE_SIZE);
-	int ret  = map_range_in_pgtbl(vmspace->pgtbl,fault_addr,pa,PAGE_SIZE,vmr->perm);
-	if(ret<0)
-	{
+	/*
+	 * 3. Allocate one physical memory page for the PMO
+	 * The page is recorded in the PMO, so another vmspace mapping it
+	 * (e.g. the other end of an IPC buffer) finds the same one.
+	 */
+	fault_addr = ROUND_DOWN(fault_addr, PAGE_SIZE);
+	index = (fault_addr - vmr->start) / PAGE_SIZE;
+	lock(&pmo->lock);
+	pa = get_page_from_pmo(pmo, index);
+	if (pa == 0) {
+		page = get_pages(0);
+		if (page == NULL) {
+			unlock(&pmo->lock);
+			kinfo("handle_trans_fault get_pages failed\n");
+			goto out_unlock_pgtbl;
+		}
+		/* The page may be shared, never leak old contents */
+		memset(page, 0, PAGE_SIZE);
+		pa = (paddr_t)virt_to_phys((vaddr_t)page);
+		commit_page_to_pmo(pmo, index, pa);
+	}
+	unlock(&pmo->lock);
+
+	/* 4. Map the allocated address back to the page table */
+	if (map_range_in_pgtbl(vmspace->pgtbl, fault_addr, pa, PAGE_SIZE,
+			       vmr->perm) < 0) {
 		kinfo("map_range_in_pgtbl failed\n");
-		return -ENOMAPPING;
+		goto out_unlock_pgtbl;
 	}
-	
-	kinfo("finish handle_trans_fault\n");
-	return 0;
+
+	kdebug("finish handle_trans_fault\n");
+	ret = 0;
+ out_unlock_pgtbl:
+	unlock(&vmspace->pgtbl_lock);
+ out_unlock:
+	read_unlock(&vmspace->vmr_lock);
+	return ret;
 }
@@ -19,8 +19,19 @@
 #include <exception/timer.h>
 #include <process/thread.h>
 #include <sched/sched.h>
+#include <sched/timer_wheel.h>
+
+#define CNTKCTL_EL0PCTEN	(1UL << 0)
+#define CNTKCTL_EVNTEN		(1UL << 2)
+#define CNTKCTL_EVNTDIR		(1UL << 3)
+#define CNTKCTL_EVNTI_SHIFT	(4)
+#define CNTKCTL_EVNTI_MASK	(0xfUL << CNTKCTL_EVNTI_SHIFT)
+/* Bit 12 of the counter: ~130us at 62.5MHz */
+#define TIMER_EVNTI		(12)
 
 u64 cntv_tval;
+/* Frequency of the generic timer counter (Hz) */
+u64 cntp_freq;
 
 /* Per core IRQ SOURCE MMIO address */
 u64 core_timer_irqcntl[PLAT_CPU_NUM] = {
@@ -43,10 +54,25 @@ void timer_init(void)
 	asm volatile ("mrs %0, cntfrq_el0":"=r" (cur_freq));
 	kdebug("timer init cntfrq_el0 = %lu\n", cur_freq);
 
+	cntp_freq = cur_freq;
+
 	/* Calculate the tv */
-	cntv_tval = (cur_freq * TICK_MS / 1000);
+	cntv_tval = (cur_freq * TICK_US / 1000000);
 	kdebug("CPU freq %lu, set timer %lu\n", cur_freq, cntv_tval);
 
+	/*
+	 * Enable the event stream: the counter sends an event about every
+	 * 2^(TIMER_EVNTI + 1) cycles, which bounds the time any wfe based
+	 * wait may sleep if an expected event is lost.
+	 * User space may read cntpct_el0 (and cntfrq_el0), e.g. to time
+	 * benchmarks.
+	 */
+	asm volatile ("mrs %0, cntkctl_el1":"=r" (timer_ctl));
+	timer_ctl &= ~(CNTKCTL_EVNTI_MASK | CNTKCTL_EVNTDIR);
+	timer_ctl |= CNTKCTL_EVNTEN | (TIMER_EVNTI << CNTKCTL_EVNTI_SHIFT) |
+	    CNTKCTL_EL0PCTEN;
+	asm volatile ("msr cntkctl_el1, %0"::"r" (timer_ctl));
+
 	/* set the timervalue here */
 	asm volatile ("msr cntv_tval_el0, %0"::"r" (cntv_tval));
 	asm volatile ("mrs %0, cntv_tval_el0":"=r" (count_down));
@@ -83,8 +109,21 @@ void plat_enable_timer(void)
 	asm volatile ("msr cntv_ctl_el0, %0"::"r" (timer_ctl));
 }
 
+u64 plat_cycles_to_us(u64 cycles)
+{
+	/* Split the conversion so that cycles * 1000000 does not overflow */
+	return (cycles / cntp_freq) * 1000000 +
+	    (cycles % cntp_freq) * 1000000 / cntp_freq;
+}
+
+u64 plat_us_to_cycles(u64 us)
+{
+	return (us / 1000000) * cntp_freq + (us % 1000000) * cntp_freq / 1000000;
+}
+
 void handle_timer_irq(void)
 {
 	plat_handle_timer_irq();
+	timer_wheel_tick();
 	sched_handle_timer_irq();
 }
@@ -12,6 +12,20 @@
 
 #pragma once
 
+#include <common/types.h>
+
 void timer_init(void);
 void handle_timer_irq(void);
 void plat_handle_timer_irq(void);
+
+/* Read the physical counter of the generic timer */
+static inline u64 plat_get_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("mrs %0, cntpct_el0":"=r" (cnt));
+	return cnt;
+}
+
+u64 plat_cycles_to_us(u64 cycles);
+u64 plat_us_to_cycles(u64 us);
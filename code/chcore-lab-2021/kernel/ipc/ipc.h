@@ -15,26 +15,73 @@
 #pragma once
 #include <common/list.h>
 #include <process/thread.h>
+#include <ipc/notification.h>
 
 /*
  * Used in both server and client register.
- * Stack setting is invalid in client register.
+ * Stack and grant settings are invalid in client register.
  */
 struct ipc_vm_config {
 	u64 stack_base_addr;
 	u64 stack_size;
 	u64 buf_base_addr;
 	u64 buf_size;
+	/*
+	 * Grant windows, one of grant_size per handler thread, where the
+	 * pages a client grants for a call show up. 0 disables grants.
+	 */
+	u64 grant_base_addr;
+	u64 grant_size;
 };
 
-#define IPC_MAX_CONN_PER_SERVER 32
+/* Upper bound of the handler threads a server asks for */
+#define IPC_MAX_HANDLER_THREADS 32
 struct server_ipc_config {
 	// I dont know how to specify the maximum callback number
 	u64 callback;
-	u64 max_client;
-	/* bitmap for shared buffer and stack allocation */
+	/*
+	 * Pool of handler threads, each with its own stack. A call takes an
+	 * idle one for its duration, callers wait when there is none.
+	 */
+	u64 handler_num;
+	/*
+	 * CPU the handlers run on, calls from other CPUs are handed over
+	 * to it. NO_AFF runs them on the CPU of the caller.
+	 */
+	s32 dispatch_cpu;
+	struct list_head idle_handlers;
+	struct list_head busy_handlers;
+	/* Sorted by priority, highest first */
+	struct list_head handler_waiters;
+	/* bitmap for shared buffer allocation, grows with the connections */
 	unsigned long *conn_bmp;
+	u64 conn_bmp_size;
+	/* Connections to the server, revoked when it exits */
+	struct list_head conns;
 	struct ipc_vm_config vm_config;
+	/* Backs the vmregion of each grant window, see create_handler */
+	struct pmobject grant_pmo;
+};
+
+/* A thread of the handler pool of a server */
+struct ipc_handler {
+	struct thread *thread;
+	struct server_ipc_config *server;
+	u64 stack_top;
+	struct pmobject *stack_pmo;
+	/* Grant window of the handler and how much of it is mapped */
+	u64 grant_addr;
+	u64 grant_len;
+	/* Pmobjects of the granted range, referenced for the call */
+	struct pmobject **grant_pmos;
+	u64 grant_nr_pmos;
+	/* The call being served */
+	struct ipc_connection *conn;
+	struct thread *caller;
+	/* Server whose handlers we wait for, in a nested call */
+	struct server_ipc_config *waiting;
+	/* In idle_handlers or busy_handlers */
+	struct list_head node;
 };
 
 struct shared_buf {
@@ -44,36 +91,95 @@ struct shared_buf {
 };
 
 struct ipc_connection {
-	/* Source Thread */
-	struct thread *source;
-	/* Target Thread */
+	/*
+	 * Target (server) Thread, which registered the callback. NULL once
+	 * it exited, see ipc_server_exit: the connection is dead.
+	 */
 	struct thread *target;
+	/* What the teardown needs of the target, which may be gone */
+	struct server_ipc_config *server;
+	struct vmspace *server_vmspace;
+	/* In the conns of server */
+	struct list_head server_node;
 	/* Conn cap in server */
 	u64 server_conn_cap;
 	/* Target function */
 	u64 callback;
 
-	/* Shadow server stack top */
-	u64 server_stack_top;
-	u64 server_stack_size;
-
 	/* Shared buffer */
 	struct shared_buf buf;
+	/* Backs the buffer at both ends, NULL once torn down */
+	struct pmobject *buf_pmo;
+	struct vmspace *client_vmspace;
+	/* Slot of the buffer in the server, see alloc_conn_idx */
+	u64 conn_idx;
+	/* Calls being served, the connection cannot be closed meanwhile */
+	u64 calls;
+
+	/*
+	 * Signals between the two ends for asynchronous use of the shared
+	 * buffer (e.g. the rings of user/lib/ipc_ring.c), one for each end
+	 * to wait on.
+	 */
+	struct notification server_notifc;
+	struct notification client_notifc;
 };
 
+/*
+ * Register IPC carries x0-x7 both ways, the connection cap goes in the
+ * upper half of x8 (see el0_ipc_fast).
+ */
+#define IPC_FAST_MSG_REGS 8
+
 typedef struct ipc_msg {
 	u64 server_conn_cap;
 	u64 data_len;
 	u64 cap_slot_number;
 	u64 data_offset;
 	u64 cap_slots_offset;
+	/*
+	 * Pages of the client lent to the server for the call, without
+	 * copy. The kernel replaces grant_addr with the address in the
+	 * grant window of the server, see ipc_grant.c.
+	 */
+	u64 grant_addr;
+	u64 grant_len;
+	/* Pmobjects of the granted range, referenced for the call */
+	struct pmobject **grant_pmos;
+	u64 grant_nr_pmos;
+	u64 grant_perm;
 } ipc_msg_t;
 
 /* syscall related to IPC */
-u64 sys_register_server(u64 callback, u64 max_client, u64 vm_config_ptr);
+u64 sys_register_server(u64 callback, u64 handler_num, u64 vm_config_ptr,
+			u64 dispatch_cpu);
 u32 sys_register_client(u32 server_cap, u64 vm_config_ptr);
 u64 sys_ipc_call(u32 conn_cap, ipc_msg_t * ipc_msg);
 u64 sys_ipc_reg_call(u32 conn_cap, u64 arg);
 void sys_ipc_return(u64 ret);
+u64 sys_ipc_fast_call(u64 conn_cap);
+u64 sys_ipc_fast_return(void);
+int sys_ipc_notify(u32 conn_cap);
+int sys_ipc_wait(u32 conn_cap, bool is_block, u64 timeout_us);
+int sys_ipc_close(u32 conn_cap);
+int sys_ipc_publish(u64 name_ptr, u64 name_len);
+int sys_ipc_unpublish(u64 name_ptr, u64 name_len);
+int sys_ipc_lookup(u64 name_ptr, u64 name_len, u64 vm_config_ptr);
+void ipc_unpublish_thread(struct thread *thread);
+int ipc_connect(struct thread *server, u64 vm_config_ptr);
+void ipc_server_exit(struct thread *thread);
+
+void ipc_conn_teardown(struct ipc_connection *conn);
+void connection_deinit(void *ptr);
+
+/* Handler pool, see ipc_server.c */
+struct ipc_handler *ipc_get_handler(struct server_ipc_config *server);
+void ipc_put_handler(struct ipc_handler *handler);
+void ipc_wait_handler(struct server_ipc_config *server);
+u64 ipc_switch_to(struct thread *target, u32 cpuid);
+
+/* Grant windows, see ipc_grant.c */
+int ipc_grant_map(struct ipc_handler *handler, ipc_msg_t *ipc_msg);
+void ipc_grant_unmap(struct ipc_handler *handler);
 
 #define LAB4_IPC_BLANK 0
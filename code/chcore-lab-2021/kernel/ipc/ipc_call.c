@@ -14,6 +14,7 @@
 #include <common/kprint.h>
 #include <common/macro.h>
 #include <common/util.h>
+#include <common/smp.h>
 #include <ipc/ipc.h>
 #include <exception/exception.h>
 #include <common/kmalloc.h>
@@ -25,128 +26,140 @@
 
 /**
  * A helper function to transfer all the ipc_msg's capbilities of client's
- * process to server's process
+ * process to server's process. The caps are copied in one batch and the
+ * slots of the server are written back over the client's in place.
  */
 #define MAX_CAP_TRANSFER 8
+#if MAX_CAP_TRANSFER > CAP_COPY_BATCH_MAX
+#error "MAX_CAP_TRANSFER is larger than a cap_copy_batch"
+#endif
 int ipc_send_cap(struct ipc_connection *conn, ipc_msg_t *ipc_msg)
 {
+	u64 cap_buf[MAX_CAP_TRANSFER];
+	/* cap_slot_number, data_offset and cap_slots_offset */
+	u64 hdr[3];
+	u64 cap_slot_number, cap_slots_offset;
 	int i, r;
-	u64 cap_slot_number;
-	u64 cap_slots_offset;
-	u64 *cap_buf;
 
-	r = copy_from_user((char *)&cap_slot_number,
-					   (char *)&ipc_msg->cap_slot_number,
-					   sizeof(cap_slot_number));
+	r = copy_from_user((char *)hdr, (char *)&ipc_msg->cap_slot_number,
+			   sizeof(hdr));
 	if (r < 0)
-		goto out;
+		return r;
+	cap_slot_number = hdr[0];
+	cap_slots_offset = hdr[2];
 	if (likely(cap_slot_number == 0))
-	{
-		r = 0;
-		goto out;
-	}
-	else if (cap_slot_number >= MAX_CAP_TRANSFER)
-	{
-		r = -EINVAL;
-		goto out;
-	}
+		return 0;
+	if (cap_slot_number > MAX_CAP_TRANSFER)
+		return -EINVAL;
 
-	r = copy_from_user((char *)&cap_slots_offset,
-					   (char *)&ipc_msg->cap_slots_offset,
-					   sizeof(cap_slots_offset));
+	r = copy_from_user((char *)cap_buf, (char *)ipc_msg + cap_slots_offset,
+			   sizeof(*cap_buf) * cap_slot_number);
 	if (r < 0)
-		goto out;
+		return r;
 
-	cap_buf = kmalloc(cap_slot_number * sizeof(*cap_buf));
-	if (!cap_buf)
-	{
-		r = -ENOMEM;
-		goto out;
-	}
-
-	r = copy_from_user((char *)cap_buf, (char *)ipc_msg + cap_slots_offset,
-					   sizeof(*cap_buf) * cap_slot_number);
+	r = cap_copy_batch(current_process, conn->target->process, cap_buf,
+			   cap_slot_number);
 	if (r < 0)
-		goto out;
+		return r;
 
-	for (i = 0; i < cap_slot_number; i++)
-	{
-		u64 dest_cap;
-
-		kdebug("[IPC] send cap:%d\n", cap_buf[i]);
-		dest_cap = cap_copy(current_process, conn->target->process,
-							cap_buf[i], false, 0);
-		if (dest_cap < 0)
-			goto out_free_cap;
-		cap_buf[i] = dest_cap;
+	r = copy_to_user((char *)ipc_msg + cap_slots_offset, (char *)cap_buf,
+			 sizeof(*cap_buf) * cap_slot_number);
+	if (r < 0) {
+		for (i = 0; i < cap_slot_number; i++)
+			cap_free(conn->target->process, cap_buf[i]);
 	}
+	return r;
+}
 
-	r = copy_to_user((char *)ipc_msg + cap_slots_offset, (char *)cap_buf,
-					 sizeof(*cap_buf) * cap_slot_number);
-	if (r < 0)
-		goto out_free_cap;
+/*
+ * Get the connection of the cap for a call. NULL if there is none, or if
+ * its server exited (see ipc_server_exit): both are -ECAPBILITY.
+ */
+static struct ipc_connection *ipc_get_conn(u32 conn_cap)
+{
+	struct ipc_connection *conn;
 
-	kfree(cap_buf);
-	return 0;
+	conn = obj_get(current_process, conn_cap, TYPE_CONNECTION);
+	if (conn && !conn->target) {
+		obj_put(conn);
+		return NULL;
+	}
+	return conn;
+}
 
-out_free_cap:
-	for (--i; i >= 0; i--)
-		cap_free(conn->target->process, cap_buf[i]);
-	kfree(cap_buf);
-out:
-	return r;
+/*
+ * Take a handler thread of the server of conn for the call of the current
+ * thread. When all of them are busy, drop conn, wait and restart the
+ * syscall: callers claim one before any side effect of the call.
+ */
+static struct ipc_handler *ipc_claim_handler(struct ipc_connection *conn)
+{
+	struct server_ipc_config *server = conn->server;
+	struct ipc_handler *handler;
+
+	handler = ipc_get_handler(server);
+	if (!handler) {
+		obj_put(conn);
+		ipc_wait_handler(server);
+	}
+	return handler;
 }
 
-/**
- * Lab4 - exercise 16
- * Helper function
- * Client thread calls this function and then return to server thread
- * This function should never return
- *
- * Replace the place_holder to correct value!
+/*
+ * Bind the current thread's call to the handler thread: the client waits
+ * and its scheduling context runs the handler from the callback on its
+ * own stack. The handler keeps the reference on conn until it is put
+ * back.
  */
-static u64 thread_migrate_to_server(struct ipc_connection *conn, u64 arg)
+static struct thread *ipc_bind_server(struct ipc_connection *conn,
+				      struct ipc_handler *handler)
 {
-	struct thread *target = conn->target;
+	struct thread *target = handler->thread;
 
-	conn->source = current_thread;
-	target->active_conn = conn;
+	handler->conn = conn;
+	handler->caller = current_thread;
+	conn->calls++;
 	current_thread->thread_ctx->state = TS_WAITING;
-	obj_put(conn);
 
-	/**
-	 * Lab4 - exercise 16
-	 * This command set the sp register, read the file to find which field
-	 * of the ipc_connection stores the stack of the server thread?
-	 * */
 	/*
 	 * 这个stack是sp哦所以是栈顶
 	 */
-	arch_set_thread_stack(target, conn->server_stack_top);
-	/**
-	 * Lab4 - exercise 16
-	 * This command set the ip register, read the file to find which field
-	 * of the ipc_connection stores the instruction to be called when switch
-	 * to the server?
-	 * */
-	arch_set_thread_next_ip(target, conn->target->server_ipc_config->callback);
-	/**
-	 * Lab4 - exercise 16
-	 * The argument set by sys_ipc_call;
-	 */
-	arch_set_thread_arg(target, arg);
+	arch_set_thread_stack(target, handler->stack_top);
+	arch_set_thread_next_ip(target, conn->callback);
 
 	/**
 	 * Passing the scheduling context of the current thread to thread of
 	 * connection
+	 * The handler also runs at the priority of the caller. Both go
+	 * down a chain of nested calls, as the caller may be a handler
+	 * itself, and the handler gives them back in ipc_put_handler.
 	 */
 	target->thread_ctx->sc = current_thread->thread_ctx->sc;
+	target->thread_ctx->prio = current_thread->thread_ctx->prio;
+	return target;
+}
+
+/**
+ * Lab4 - exercise 16
+ * Helper function
+ * Client thread calls this function and then return to server thread
+ * This function should never return
+ */
+static u64 thread_migrate_to_server(struct ipc_connection *conn,
+				    struct ipc_handler *handler, u64 arg)
+{
+	struct thread *target = ipc_bind_server(conn, handler);
+
+	/**
+	 * Lab4 - exercise 16
+	 * The argument set by sys_ipc_call;
+	 */
+	arch_set_thread_arg(target, arg);
 
 	/**
 	 * Switch to the server
 	 */
-	switch_to_thread(target);
-	eret_to_thread(switch_context());
+	eret_to_thread(ipc_switch_to(target, smp_get_cpu_id()));
 
 	/* Function never return */
 	BUG_ON(1);
@@ -165,10 +178,11 @@ static u64 thread_migrate_to_server(struct ipc_connection *conn, u64 arg)
 u64 sys_ipc_call(u32 conn_cap, ipc_msg_t *ipc_msg)
 {
 	struct ipc_connection *conn = NULL;
+	struct ipc_handler *handler;
 	u64 arg;
 	int r;
 
-	conn = obj_get(current_thread->process, conn_cap, TYPE_CONNECTION);
+	conn = ipc_get_conn(conn_cap);
 	if (!conn)
 	{
 		r = -ECAPBILITY;
@@ -186,9 +200,16 @@ u64 sys_ipc_call(u32 conn_cap, ipc_msg_t *ipc_msg)
 	if (r < 0)
 		goto out_obj_put;
 
+	handler = ipc_claim_handler(conn);
+
+	/* Before the caps, which are not taken back on failure */
+	r = ipc_grant_map(handler, ipc_msg);
+	if (r < 0)
+		goto out_put_handler;
+
 	r = ipc_send_cap(conn, ipc_msg);
 	if (r < 0)
-		goto out_obj_put;
+		goto out_put_handler;
 
 	/**
 	 * Lab4 - exercise 16
@@ -201,9 +222,11 @@ u64 sys_ipc_call(u32 conn_cap, ipc_msg_t *ipc_msg)
 	 * 是共享内存在server的虚拟地址
 	 */
 	arg = conn->buf.server_user_addr;
-	thread_migrate_to_server(conn, arg);
+	thread_migrate_to_server(conn, handler, arg);
 
 	BUG("This function should never\n");
+out_put_handler:
+	ipc_put_handler(handler);
 out_obj_put:
 	obj_put(conn);
 out_fail:
@@ -218,20 +241,45 @@ out_fail:
 u64 sys_ipc_reg_call(u32 conn_cap, u64 arg0)
 {
 	struct ipc_connection *conn = NULL;
-	int r;
+	struct ipc_handler *handler;
 
-	conn = obj_get(current_thread->process, conn_cap, TYPE_CONNECTION);
+	conn = ipc_get_conn(conn_cap);
 	if (!conn)
 	{
 		return -ECAPBILITY;
 		
 	}
 
-	thread_migrate_to_server(conn, arg0);
+	handler = ipc_claim_handler(conn);
+	thread_migrate_to_server(conn, handler, arg0);
 
 	BUG("sys_ipc_reg_call should never reach here\n");
+	return 0;
+}
 
-	obj_put(conn);
+/*
+ * Register IPC fast path, entered from el0_ipc_fast with the big kernel
+ * lock held and x0-x7 of the client saved in its context. The message is
+ * copied to the server thread, which starts at its callback like with
+ * sys_ipc_reg_call. Returns the context to eret to.
+ */
+u64 sys_ipc_fast_call(u64 conn_cap)
+{
+	struct ipc_connection *conn;
+	struct ipc_handler *handler;
+	struct thread *target;
+	u64 *regs = current_thread->thread_ctx->ec.reg;
 
-	return r;
+	conn = ipc_get_conn(conn_cap);
+	if (!conn) {
+		regs[X0] = -ECAPBILITY;
+		return (u64)regs;
+	}
+
+	handler = ipc_claim_handler(conn);
+	target = ipc_bind_server(conn, handler);
+	memcpy(target->thread_ctx->ec.reg, regs,
+	       IPC_FAST_MSG_REGS * sizeof(u64));
+
+	return ipc_switch_to(target, smp_get_cpu_id());
 }
@@ -22,51 +22,86 @@
 #include <process/thread.h>
 #include <sched/context.h>
 #include <sched/sched.h>
+#include <common/bitops.h>
 
-#define SHADOW_THREAD_PRIO MAX_PRIO - 1
+/*
+ * Pick a free shared buffer slot of the server. The bitmap doubles when
+ * it is full, so the number of connections is not bounded here.
+ */
+static int alloc_conn_idx(struct server_ipc_config *config)
+{
+	unsigned long *bmp;
+	u64 size = config->conn_bmp_size;
+	int idx;
 
-/**
- * Helper function called when an ipc_connection is created
+	idx = find_next_zero_bit(config->conn_bmp, size, 0);
+	if (idx >= size) {
+		bmp = kzalloc(BITS_TO_LONGS(size * 2) * sizeof(long));
+		if (!bmp)
+			return -ENOMEM;
+		memcpy(bmp, config->conn_bmp, BITS_TO_LONGS(size) * sizeof(long));
+		kfree(config->conn_bmp);
+		config->conn_bmp = bmp;
+		config->conn_bmp_size = size * 2;
+		idx = size;
+	}
+	set_bit(idx, config->conn_bmp);
+	return idx;
+}
+
+/*
+ * Unmap the shared buffer from both ends and free it, give its slot back
+ * to the server and wake up whoever waits on the connection. Safe to
+ * call more than once, and after the server exited.
  */
-static struct thread *create_server_thread(struct thread *src)
+void ipc_conn_teardown(struct ipc_connection *conn)
 {
-	struct thread *new;
+	struct server_ipc_config *config = conn->server;
 
-	new = kmalloc(sizeof(struct thread));
-	BUG_ON(new == NULL);
+	if (!conn->buf_pmo)
+		return;
 
-	new->vmspace = obj_get(src->process, VMSPACE_OBJ_ID, TYPE_VMSPACE);
-	BUG_ON(!new->vmspace);
+	list_del(&conn->server_node);
+	if (conn->buf.client_user_addr)
+		vmspace_unmap_range(conn->client_vmspace,
+				    conn->buf.client_user_addr, conn->buf.size);
+	if (conn->buf.server_user_addr)
+		vmspace_unmap_range(conn->server_vmspace,
+				    conn->buf.server_user_addr, conn->buf.size);
+	/* A grant of the buffer to a server may keep it alive a while */
+	pmo_put(conn->buf_pmo);
+	conn->buf_pmo = NULL;
+	clear_bit(conn->conn_idx, config->conn_bmp);
 
-	// Init the thread ctx
-	new->thread_ctx = create_thread_ctx();
-	if (!new->thread_ctx)
-		goto out_fail;
-	memcpy((char *)&(new->thread_ctx->ec),
-	       (const char *)&(src->thread_ctx->ec), sizeof(arch_exec_cont_t));
-	new->thread_ctx->prio = SHADOW_THREAD_PRIO;
-	new->thread_ctx->state = TS_INIT;
-	new->thread_ctx->affinity = NO_AFF;
-	new->thread_ctx->sc = NULL;
-	new->thread_ctx->type = TYPE_SHADOW;
-
-	// Init the server ipc
-	new->server_ipc_config = kzalloc(sizeof(struct server_ipc_config));
-	if (!new->server_ipc_config)
-		goto out_destroy_thread_ctx;
-	new->server_ipc_config->callback = src->server_ipc_config->callback;
-	new->server_ipc_config->vm_config = src->server_ipc_config->vm_config;
-	new->process = src->process;
-
-	obj_put(new->vmspace);
-	return new;
-
- out_destroy_thread_ctx:
-	destroy_thread_ctx(new);
- out_fail:
-	obj_put(new->vmspace);
-	kfree(new);
-	return NULL;
+	notification_deinit(&conn->server_notifc);
+	notification_deinit(&conn->client_notifc);
+}
+
+/* The last cap of the connection is gone */
+void connection_deinit(void *ptr)
+{
+	ipc_conn_teardown(ptr);
+}
+
+/*
+ * The server thread is going away: revoke its connections, so that they
+ * never use it again. Calls on them fail with -ECAPBILITY from now on,
+ * the caps stay until closed. A connection with calls being served is
+ * torn down when the last one returns, see ipc_put_handler.
+ */
+void ipc_server_exit(struct thread *thread)
+{
+	struct server_ipc_config *config = thread->server_ipc_config;
+	struct ipc_connection *conn, *tmp;
+
+	if (!config)
+		return;
+
+	for_each_in_list_safe(conn, tmp, server_node, &config->conns) {
+		conn->target = NULL;
+		if (!conn->calls)
+			ipc_conn_teardown(conn);
+	}
 }
 
 /**
@@ -78,50 +113,46 @@ static int create_connection(struct thread *source, struct thread *target,
 	struct ipc_connection *conn = NULL;
 	int ret = 0;
 	int conn_cap = 0, server_conn_cap = 0;
-	struct pmobject *stack_pmo, *buf_pmo;
+	struct pmobject *buf_pmo;
 	int conn_idx;
 	struct server_ipc_config *server_ipc_config;
 	struct ipc_vm_config *vm_config;
-	u64 server_stack_base, server_buf_base, client_buf_base;
-	u64 stack_size, buf_size;
+	u64 server_buf_base, client_buf_base;
+	u64 buf_size;
 
 	BUG_ON(source == NULL);
 	BUG_ON(target == NULL);
 
+	// Get the server's ipc config
+	server_ipc_config = target->server_ipc_config;
+	if (!server_ipc_config) {
+		ret = -EINVAL;
+		goto out_fail;
+	}
+	vm_config = &server_ipc_config->vm_config;
+
 	// Get the ipc_connection
 	conn = obj_alloc(TYPE_CONNECTION, sizeof(*conn));
 	if (!conn) {
 		ret = -ENOMEM;
 		goto out_fail;
 	}
-	conn->target = create_server_thread(target);
-	if (!conn->target) {
-		ret = -ENOMEM;
-		goto out_fail;
-	}
-	// Get the server's ipc config
-	server_ipc_config = target->server_ipc_config;
-	vm_config = &server_ipc_config->vm_config;
-	conn_idx = find_next_zero_bit(server_ipc_config->conn_bmp,
-				      server_ipc_config->max_client, 0);
-	set_bit(conn_idx, server_ipc_config->conn_bmp);
-
-	// Create the server thread's stack
-	server_stack_base =
-	    vm_config->stack_base_addr + conn_idx * vm_config->stack_size;
-	stack_size = vm_config->stack_size;
-	kdebug("server stack base:%lx size:%lx\n", server_stack_base,
-	       stack_size);
-	stack_pmo = kmalloc(sizeof(struct pmobject));
-	if (!stack_pmo) {
-		ret = -ENOMEM;
+	/* Calls are served by the handler threads of the server */
+	conn->target = target;
+	conn->server = server_ipc_config;
+	conn->server_vmspace = target->vmspace;
+	conn->callback = server_ipc_config->callback;
+	conn->buf_pmo = NULL;
+	conn->calls = 0;
+	notification_init(&conn->server_notifc);
+	notification_init(&conn->client_notifc);
+
+	conn_idx = alloc_conn_idx(server_ipc_config);
+	if (conn_idx < 0) {
+		ret = conn_idx;
 		goto out_free_obj;
 	}
-	pmo_init(stack_pmo, PMO_DATA, stack_size, 0);
-	vmspace_map_range(target->vmspace, server_stack_base, stack_size,
-			  VMR_READ | VMR_WRITE, stack_pmo);
-
-	conn->server_stack_top = server_stack_base + stack_size;
+	conn->conn_idx = conn_idx;
 
 	// Create and map the shared buffer for client and server
 	server_buf_base =
@@ -129,30 +160,50 @@ static int create_connection(struct thread *source, struct thread *target,
 	client_buf_base = client_vm_config->buf_base_addr;
 	buf_size = MIN(vm_config->buf_size, client_vm_config->buf_size);
 	client_vm_config->buf_size = buf_size;
+	/* The slots grow with the bitmap, past what register_server checked */
+	if (!is_user_addr_range(server_buf_base, vm_config->buf_size)) {
+		ret = -ENOSPC;
+		goto out_free_idx;
+	}
 	kdebug("server buf base:%lx size:%lx, client base:%lx\n",
-	       server_stack_base, stack_size, client_buf_base);
+	       server_buf_base, buf_size, client_buf_base);
 
+	/* Populated on fault, a connection only costs the pages it uses */
 	buf_pmo = kmalloc(sizeof(struct pmobject));
 	if (!buf_pmo) {
 		ret = -ENOMEM;
-		goto out_free_stack_pmo;
+		goto out_free_idx;
 	}
-	pmo_init(buf_pmo, PMO_DATA, buf_size, 0);
-
-	vmspace_map_range(current_thread->vmspace, client_buf_base, buf_size,
-			  VMR_READ | VMR_WRITE, buf_pmo);
-	vmspace_map_range(target->vmspace, server_buf_base, buf_size,
-			  VMR_READ | VMR_WRITE, buf_pmo);
+	pmo_init(buf_pmo, PMO_ANONYM, buf_size, 0);
+	buf_pmo->refcnt = 1;
 
 	conn->buf.client_user_addr = client_buf_base;
 	conn->buf.server_user_addr = server_buf_base;
+	conn->buf.size = buf_size;
+	conn->buf_pmo = buf_pmo;
+	conn->client_vmspace = source->vmspace;
+	list_add(&conn->server_node, &server_ipc_config->conns);
+
+	ret = vmspace_map_range(source->vmspace, client_buf_base, buf_size,
+				VMR_READ | VMR_WRITE, buf_pmo);
+	if (ret < 0) {
+		conn->buf.client_user_addr = 0;
+		goto out_teardown;
+	}
+	ret = vmspace_map_range(target->vmspace, server_buf_base, buf_size,
+				VMR_READ | VMR_WRITE, buf_pmo);
+	if (ret < 0) {
+		conn->buf.server_user_addr = 0;
+		goto out_teardown;
+	}
 
 	conn_cap = cap_alloc(current_process, conn, 0);
 	if (conn_cap < 0) {
 		ret = conn_cap;
-		goto out_free_obj;
+		goto out_teardown;
 	}
 
+	/* From now on connection_deinit cleans up with the last cap */
 	server_conn_cap =
 	    cap_copy(current_process, target->process, conn_cap, 0, 0);
 	if (server_conn_cap < 0) {
@@ -162,18 +213,25 @@ static int create_connection(struct thread *source, struct thread *target,
 	conn->server_conn_cap = server_conn_cap;
 
 	return conn_cap;
- out_free_stack_pmo:
-	kfree(stack_pmo);
+ out_teardown:
+	ipc_conn_teardown(conn);
+	goto out_free_obj;
+ out_free_idx:
+	clear_bit(conn_idx, server_ipc_config->conn_bmp);
  out_free_obj:
 	obj_free(conn);
  out_fail:
 	return ret;
 }
 
-u32 sys_register_client(u32 server_cap, u64 vm_config_ptr)
+/*
+ * Connect the current thread to server with the client buffer described
+ * at vm_config_ptr, whose size is updated if the server's is smaller.
+ * Returns the connection cap. The caller holds a reference on server.
+ */
+int ipc_connect(struct thread *server, u64 vm_config_ptr)
 {
 	struct thread *client = current_thread;
-	struct thread *server = NULL;
 	struct ipc_connection *conn;
 	struct ipc_vm_config vm_config = { 0 };
 	u64 client_buf_size;
@@ -191,17 +249,11 @@ u32 sys_register_client(u32 server_cap, u64 vm_config_ptr)
 		goto out_fail;
 	}
 
-	server = obj_get(current_thread->process, server_cap, TYPE_THREAD);
-	if (!server) {
-		r = -ECAPBILITY;
-		goto out_fail;
-	}
-
 	client_buf_size = vm_config.buf_size;
 	conn_cap = create_connection(client, server, &vm_config);
 	if (conn_cap < 0) {
 		r = conn_cap;
-		goto out_obj_put_thread;
+		goto out_fail;
 	}
 
 	conn = obj_get(current_process, conn_cap, TYPE_CONNECTION);
@@ -216,8 +268,43 @@ u32 sys_register_client(u32 server_cap, u64 vm_config_ptr)
 	r = conn_cap;
  out_obj_put_conn:
 	obj_put(conn);
- out_obj_put_thread:
-	obj_put(server);
  out_fail:
 	return r;
 }
+
+u32 sys_register_client(u32 server_cap, u64 vm_config_ptr)
+{
+	struct thread *server;
+	int r;
+
+	server = obj_get(current_thread->process, server_cap, TYPE_THREAD);
+	if (!server)
+		return -ECAPBILITY;
+
+	r = ipc_connect(server, vm_config_ptr);
+	obj_put(server);
+	return r;
+}
+
+/*
+ * Close a connection from either end: its buffer is freed and the caps
+ * of both ends are revoked. Fails with -EBUSY while a call is served.
+ */
+int sys_ipc_close(u32 conn_cap)
+{
+	struct ipc_connection *conn;
+
+	conn = obj_get(current_process, conn_cap, TYPE_CONNECTION);
+	if (!conn)
+		return -ECAPBILITY;
+
+	if (conn->calls) {
+		obj_put(conn);
+		return -EBUSY;
+	}
+
+	ipc_conn_teardown(conn);
+	obj_free(conn);
+	obj_put(conn);
+	return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+/*
+ * Grant windows: a client lends a page-aligned range of its memory to the
+ * server for one call. The physical pages of the range are mapped in the
+ * grant window of the handler thread serving the call and unmapped when
+ * it returns, so large payloads (e.g. file data) are never copied.
+ */
+
+#include <common/errno.h>
+#include <common/kmalloc.h>
+#include <common/kprint.h>
+#include <common/lock.h>
+#include <common/macro.h>
+#include <common/mm.h>
+#include <common/mmu.h>
+#include <common/uaccess.h>
+#include <ipc/ipc.h>
+#include <mm/page_table.h>
+#include <mm/vmspace.h>
+
+#define GRANT_PERM_MASK (VMR_READ | VMR_WRITE)
+
+/*
+ * The range must be covered by regions of the client allowing perm.
+ * Returns how many regions cover it.
+ */
+static int grant_check_range(struct vmspace *vmspace, vaddr_t va, size_t len,
+			     vmr_prop_t perm)
+{
+	struct vmregion *vmr;
+	vaddr_t end = va + len;
+	int nr = 0;
+
+	while (va < end) {
+		vmr = find_vmr_for_va(vmspace, va);
+		if (!vmr || (vmr->perm & perm) != perm)
+			return -EINVAL;
+		va = vmr->start + vmr->size;
+		nr++;
+	}
+	return nr;
+}
+
+/*
+ * Anonymous regions are populated on fault: make sure every page of the
+ * range is present before looking for them under the vmspace locks,
+ * handle_trans_fault takes them itself.
+ */
+static void grant_populate(struct vmspace *vmspace, vaddr_t va, size_t len)
+{
+	paddr_t pa;
+	pte_t *pte;
+	vaddr_t end = va + len;
+	int r;
+
+	for (; va < end; va += PAGE_SIZE) {
+		lock(&vmspace->pgtbl_lock);
+		r = query_in_pgtbl(vmspace->pgtbl, va, &pa, &pte);
+		unlock(&vmspace->pgtbl_lock);
+		if (r < 0)
+			handle_trans_fault(vmspace, va);
+	}
+}
+
+/*
+ * Take a reference on the pmobjects behind the range, so the client
+ * cannot free them (e.g. by closing the connection of a buffer) while
+ * the server uses the pages. Called with the vmr_lock held.
+ */
+static int grant_get_pmos(struct ipc_handler *handler, struct vmspace *vmspace,
+			  vaddr_t va, size_t len, int nr)
+{
+	struct pmobject **pmos;
+	struct vmregion *vmr;
+	vaddr_t end = va + len;
+	int i;
+
+	pmos = kmalloc(nr * sizeof(*pmos));
+	if (!pmos)
+		return -ENOMEM;
+	for (i = 0; i < nr; i++) {
+		vmr = find_vmr_for_va(vmspace, va);
+		pmo_get(vmr->pmo);
+		pmos[i] = vmr->pmo;
+		va = vmr->start + vmr->size;
+	}
+	BUG_ON(va < end);
+	handler->grant_pmos = pmos;
+	handler->grant_nr_pmos = nr;
+	return 0;
+}
+
+/*
+ * Map the range granted by the message of the current call in the window
+ * of handler and tell the server where it is. Called by the client with
+ * the handler claimed, the handler unmaps it when put back.
+ */
+int ipc_grant_map(struct ipc_handler *handler, ipc_msg_t *ipc_msg)
+{
+	struct vmspace *client = current_thread->vmspace;
+	struct vmspace *server = handler->thread->vmspace;
+	struct ipc_vm_config *vm_config = &handler->server->vm_config;
+	u64 grant[3];
+	vaddr_t va, client_va;
+	size_t len, off;
+	vmr_prop_t perm;
+	paddr_t pa;
+	pte_t *pte;
+	int r;
+
+	r = copy_from_user((char *)grant, (char *)&ipc_msg->grant_addr,
+			   sizeof(grant));
+	if (r < 0)
+		return r;
+	client_va = grant[0];
+	len = grant[1];
+	perm = grant[2];
+	if (likely(len == 0))
+		return 0;
+
+	if (len > vm_config->grant_size || (perm & ~GRANT_PERM_MASK) ||
+	    !perm || !IS_ALIGNED(client_va, PAGE_SIZE) ||
+	    !IS_ALIGNED(len, PAGE_SIZE) ||
+	    !is_user_addr_range(client_va, len))
+		return -EINVAL;
+
+	/* Do not populate anything for a range we are going to reject */
+	read_lock(&client->vmr_lock);
+	r = grant_check_range(client, client_va, len, perm);
+	read_unlock(&client->vmr_lock);
+	if (r < 0)
+		return r;
+
+	grant_populate(client, client_va, len);
+
+	/* Other threads of the client may have changed the regions meanwhile */
+	read_lock(&client->vmr_lock);
+	r = grant_check_range(client, client_va, len, perm);
+	if (r < 0)
+		goto out_unlock;
+	r = grant_get_pmos(handler, client, client_va, len, r);
+	if (r < 0)
+		goto out_unlock;
+
+	/* Unmapped as a whole by ipc_grant_unmap, even if we fail midway */
+	handler->grant_len = len;
+
+	for (off = 0; off < len; off += PAGE_SIZE) {
+		lock(&client->pgtbl_lock);
+		r = query_in_pgtbl(client->pgtbl, client_va + off, &pa, &pte);
+		unlock(&client->pgtbl_lock);
+		if (r < 0) {
+			r = -EFAULT;
+			goto out_unlock;
+		}
+
+		va = handler->grant_addr + off;
+		lock(&server->pgtbl_lock);
+		r = map_range_in_pgtbl(server->pgtbl, va, pa, PAGE_SIZE, perm);
+		unlock(&server->pgtbl_lock);
+		if (r < 0)
+			goto out_unlock;
+	}
+	read_unlock(&client->vmr_lock);
+
+	return copy_to_user((char *)&ipc_msg->grant_addr,
+			    (char *)&handler->grant_addr, sizeof(u64));
+
+ out_unlock:
+	read_unlock(&client->vmr_lock);
+	return r;
+}
+
+/*
+ * The call is over, the server loses access to the granted pages. The
+ * pmobjects go away here if the client dropped them during the call.
+ */
+void ipc_grant_unmap(struct ipc_handler *handler)
+{
+	struct vmspace *server = handler->thread->vmspace;
+	u64 i;
+
+	if (likely(handler->grant_len == 0))
+		return;
+
+	lock(&server->pgtbl_lock);
+	unmap_range_in_pgtbl(server->pgtbl, handler->grant_addr,
+			     handler->grant_len);
+	unlock(&server->pgtbl_lock);
+	handler->grant_len = 0;
+
+	for (i = 0; i < handler->grant_nr_pmos; i++)
+		pmo_put(handler->grant_pmos[i]);
+	kfree(handler->grant_pmos);
+	handler->grant_pmos = NULL;
+	handler->grant_nr_pmos = 0;
+}
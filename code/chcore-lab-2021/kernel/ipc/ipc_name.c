@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+
+/*
+ * Name service: a server thread publishes itself under a name and
+ * clients connect to it by name, without getting its thread cap from
+ * whoever spawned them. The table does not hold a reference on the
+ * servers: thread_deinit drops the names of a thread that goes away, so
+ * a restarted server can publish them again.
+ */
+
+#include <common/errno.h>
+#include <common/lock.h>
+#include <common/uaccess.h>
+#include <common/util.h>
+#include <ipc/ipc.h>
+#include <process/thread.h>
+
+#define IPC_NAME_LEN 32
+#define IPC_NAME_NUM 64
+
+struct ipc_name {
+	char name[IPC_NAME_LEN];
+	struct thread *server;
+};
+
+static struct ipc_name ipc_names[IPC_NAME_NUM];
+/* A zeroed lock is free */
+static struct lock ipc_names_lock;
+
+static int get_name(char *name, u64 name_ptr, u64 name_len)
+{
+	int r;
+
+	if (name_len == 0 || name_len >= IPC_NAME_LEN)
+		return -EINVAL;
+	r = copy_from_user(name, (char *)name_ptr, name_len);
+	if (r < 0)
+		return r;
+	name[name_len] = '\0';
+	return 0;
+}
+
+/* Called with ipc_names_lock held */
+static struct ipc_name *find_name(const char *name)
+{
+	int i;
+
+	for (i = 0; i < IPC_NAME_NUM; i++) {
+		if (ipc_names[i].server && !strcmp(ipc_names[i].name, name))
+			return &ipc_names[i];
+	}
+	return NULL;
+}
+
+/*
+ * Publish the current thread, which must have registered a server. A
+ * process may publish the same name again, e.g. from a new server thread.
+ */
+int sys_ipc_publish(u64 name_ptr, u64 name_len)
+{
+	char name[IPC_NAME_LEN];
+	struct ipc_name *entry;
+	int r, i;
+
+	r = get_name(name, name_ptr, name_len);
+	if (r < 0)
+		return r;
+	if (!current_thread->server_ipc_config)
+		return -EINVAL;
+
+	lock(&ipc_names_lock);
+	entry = find_name(name);
+	if (entry) {
+		if (entry->server->process != current_process) {
+			r = -EEXIST;
+			goto out_unlock;
+		}
+	} else {
+		for (i = 0; i < IPC_NAME_NUM && ipc_names[i].server; i++) ;
+		if (i == IPC_NAME_NUM) {
+			r = -ENOSPC;
+			goto out_unlock;
+		}
+		entry = &ipc_names[i];
+		memcpy(entry->name, name, name_len + 1);
+	}
+	entry->server = current_thread;
+ out_unlock:
+	unlock(&ipc_names_lock);
+	return r;
+}
+
+/* Withdraw a name published by the current process */
+int sys_ipc_unpublish(u64 name_ptr, u64 name_len)
+{
+	char name[IPC_NAME_LEN];
+	struct ipc_name *entry;
+	int r;
+
+	r = get_name(name, name_ptr, name_len);
+	if (r < 0)
+		return r;
+
+	lock(&ipc_names_lock);
+	entry = find_name(name);
+	if (!entry)
+		r = -ENOENT;
+	else if (entry->server->process != current_process)
+		r = -EPERM;
+	else
+		entry->server = NULL;
+	unlock(&ipc_names_lock);
+	return r;
+}
+
+/* The thread is going away, drop every name it is published under */
+void ipc_unpublish_thread(struct thread *thread)
+{
+	int i;
+
+	lock(&ipc_names_lock);
+	for (i = 0; i < IPC_NAME_NUM; i++) {
+		if (ipc_names[i].server == thread)
+			ipc_names[i].server = NULL;
+	}
+	unlock(&ipc_names_lock);
+}
+
+/*
+ * Connect to the server published under the name, see sys_register_client.
+ * The entry is valid under the lock, which only covers taking a reference
+ * on the server: connecting maps memory and may take a while.
+ */
+int sys_ipc_lookup(u64 name_ptr, u64 name_len, u64 vm_config_ptr)
+{
+	char name[IPC_NAME_LEN];
+	struct ipc_name *entry;
+	struct thread *server = NULL;
+	int r;
+
+	r = get_name(name, name_ptr, name_len);
+	if (r < 0)
+		return r;
+
+	lock(&ipc_names_lock);
+	entry = find_name(name);
+	if (entry)
+		server = obj_ref(entry->server);
+	unlock(&ipc_names_lock);
+	if (!server)
+		return -ENOENT;
+
+	r = ipc_connect(server, vm_config_ptr);
+	obj_put(server);
+	return r;
+}
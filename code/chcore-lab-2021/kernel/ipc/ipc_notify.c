@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+#include <common/errno.h>
+#include <ipc/ipc.h>
+#include <ipc/notification.h>
+#include <process/capability.h>
+#include <process/thread.h>
+
+/*
+ * Both ends of a connection hold a cap to it. The server end is the
+ * process of the server thread, the other one is the client.
+ */
+static bool is_server_end(struct ipc_connection *conn)
+{
+	return current_process == conn->target->process;
+}
+
+/* Signal the other end of the connection */
+int sys_ipc_notify(u32 conn_cap)
+{
+	struct ipc_connection *conn;
+
+	conn = obj_get(current_process, conn_cap, TYPE_CONNECTION);
+	if (!conn)
+		return -ECAPBILITY;
+	if (!conn->target) {
+		obj_put(conn);
+		return -ECAPBILITY;
+	}
+
+	if (is_server_end(conn))
+		notification_notify(&conn->client_notifc);
+	else
+		notification_notify(&conn->server_notifc);
+	obj_put(conn);
+	return 0;
+}
+
+/* Wait for a signal from the other end, like sys_wait */
+int sys_ipc_wait(u32 conn_cap, bool is_block, u64 timeout_us)
+{
+	struct ipc_connection *conn;
+	struct notification *notifc;
+
+	conn = obj_get(current_process, conn_cap, TYPE_CONNECTION);
+	if (!conn)
+		return -ECAPBILITY;
+	if (!conn->target) {
+		obj_put(conn);
+		return -ECAPBILITY;
+	}
+
+	notifc = is_server_end(conn) ? &conn->server_notifc :
+	    &conn->client_notifc;
+	return notification_wait(notifc, conn, is_block, timeout_us);
+}
@@ -28,13 +28,13 @@
  * Helper function
  * Server thread calls this function and then return to client thread
  * This function should never return
- *
- * Replace the place_holder to correct value!
  */
-static int thread_migrate_to_client(struct ipc_connection *conn, u64 ret_value)
+static int thread_migrate_to_client(struct ipc_handler *handler,
+				    u64 ret_value)
 {
-	struct thread *source = conn->source;
-	current_thread->active_conn = NULL;
+	struct thread *source = handler->caller;
+
+	ipc_put_handler(handler);
 
 	/**
 	 * Lab4 - exercise 16
@@ -42,10 +42,9 @@ static int thread_migrate_to_client(struct ipc_connection *conn, u64 ret_value)
 	 */
 	arch_set_thread_return(source, ret_value);
 	/**
-	 * Switch to the client
+	 * Switch to the client, back on the CPU it called from
 	 */
-	switch_to_thread(source);
-	eret_to_thread(switch_context());
+	eret_to_thread(ipc_switch_to(source, source->thread_ctx->cpuid));
 
 	/* Function never return */
 	BUG_ON(1);
@@ -59,16 +58,40 @@ static int thread_migrate_to_client(struct ipc_connection *conn, u64 ret_value)
  */
 void sys_ipc_return(u64 ret)
 {
-	struct ipc_connection *conn = current_thread->active_conn;
+	struct ipc_handler *handler = current_thread->ipc_handler;
 
-	if (conn == NULL) {
+	if (handler == NULL || handler->caller == NULL) {
 		WARN("An inactive thread calls ipc_return\n");
 		goto out;
 	}
 
-	thread_migrate_to_client(conn, ret);
+	thread_migrate_to_client(handler, ret);
 
 	BUG("This function should never\n");
  out:
 	return;
 }
+
+/*
+ * Reply half of the register IPC fast path: x0-x7 of the server thread go
+ * back to the client as its return registers.
+ */
+u64 sys_ipc_fast_return(void)
+{
+	struct ipc_handler *handler = current_thread->ipc_handler;
+	u64 *regs = current_thread->thread_ctx->ec.reg;
+	struct thread *source;
+
+	if (handler == NULL || handler->caller == NULL) {
+		WARN("An inactive thread calls ipc_fast_return\n");
+		regs[X0] = -EINVAL;
+		return (u64)regs;
+	}
+
+	source = handler->caller;
+	ipc_put_handler(handler);
+	memcpy(source->thread_ctx->ec.reg, regs,
+	       IPC_FAST_MSG_REGS * sizeof(u64));
+
+	return ipc_switch_to(source, source->thread_ctx->cpuid);
+}
@@ -16,43 +16,356 @@
 #include <common/util.h>
 #include <ipc/ipc.h>
 #include <exception/irq.h>
+#include <exception/exception.h>
 #include <common/kmalloc.h>
 #include <common/mm.h>
 #include <common/uaccess.h>
 #include <process/thread.h>
 #include <sched/context.h>
 #include <sched/sched.h>
+#include <common/bitops.h>
+#include <common/registers.h>
+#include <common/smp.h>
 
 #define SHADOW_THREAD_PRIO MAX_PRIO - 1
+/* Size of the svc instruction, to restart an IPC syscall */
+#define SVC_INSN_SIZE 4
+
+/*
+ * Create the handler threads of a server. They share the vmspace of the
+ * server and start from its context, each one with a stack of its own.
+ * Returns an ERR_PTR on failure.
+ */
+static struct ipc_handler *create_handler(struct thread *server, u64 idx)
+{
+	struct server_ipc_config *config = server->server_ipc_config;
+	struct ipc_vm_config *vm_config = &config->vm_config;
+	struct ipc_handler *handler;
+	struct pmobject *stack_pmo;
+	struct thread *new;
+	u64 stack_base, grant_base;
+	int r = -ENOMEM;
+
+	handler = kzalloc(sizeof(*handler));
+	if (!handler)
+		goto out_fail;
+	new = kzalloc(sizeof(struct thread));
+	if (!new)
+		goto out_free_handler;
+	stack_pmo = kmalloc(sizeof(struct pmobject));
+	if (!stack_pmo)
+		goto out_free_thread;
+
+	new->vmspace = server->vmspace;
+	new->process = server->process;
+	new->ipc_handler = handler;
+
+	// Init the thread ctx
+	new->thread_ctx = create_thread_ctx();
+	if (!new->thread_ctx)
+		goto out_free_stack_pmo;
+	memcpy((char *)&(new->thread_ctx->ec),
+	       (const char *)&(server->thread_ctx->ec),
+	       sizeof(arch_exec_cont_t));
+	new->thread_ctx->prio = SHADOW_THREAD_PRIO;
+	new->thread_ctx->state = TS_WAITING;
+	new->thread_ctx->affinity = config->dispatch_cpu;
+	new->thread_ctx->sc = NULL;
+	new->thread_ctx->type = TYPE_SHADOW;
+	init_list_head(&new->notification_queue_node);
+	wheel_timer_init(&new->wait_timer, sched_wait_timeout);
+
+	/*
+	 * Create the handler thread's stack, populated on fault: most
+	 * handlers only touch the top pages of it.
+	 */
+	stack_base = vm_config->stack_base_addr + idx * vm_config->stack_size;
+	kdebug("handler stack base:%lx size:%lx\n", stack_base,
+	       vm_config->stack_size);
+	pmo_init(stack_pmo, PMO_ANONYM, vm_config->stack_size, 0);
+	r = vmspace_map_range(server->vmspace, stack_base,
+			      vm_config->stack_size, VMR_READ | VMR_WRITE,
+			      stack_pmo);
+	if (r < 0) {
+		kwarn("handler stack at %lx cannot be mapped: %d\n",
+		      stack_base, r);
+		goto out_deinit_stack_pmo;
+	}
+
+	/*
+	 * Reserve the grant window, so that nothing else is mapped there.
+	 * Only ipc_grant_map puts pages in it, a fault in it is fatal.
+	 */
+	grant_base = vm_config->grant_base_addr + idx * vm_config->grant_size;
+	if (vm_config->grant_size) {
+		r = vmspace_map_range(server->vmspace, grant_base,
+				      vm_config->grant_size, VMR_READ | VMR_WRITE,
+				      &config->grant_pmo);
+		if (r < 0) {
+			kwarn("grant window at %lx cannot be mapped: %d\n",
+			      grant_base, r);
+			goto out_unmap_stack;
+		}
+	}
+	sched_stat_register(new);
+
+	handler->thread = new;
+	handler->server = config;
+	handler->stack_top = stack_base + vm_config->stack_size;
+	handler->stack_pmo = stack_pmo;
+	handler->grant_addr = grant_base;
+	return handler;
+
+ out_unmap_stack:
+	vmspace_unmap_range(server->vmspace, stack_base, vm_config->stack_size);
+ out_deinit_stack_pmo:
+	pmo_deinit(stack_pmo);
+	destroy_thread_ctx(new);
+ out_free_stack_pmo:
+	kfree(stack_pmo);
+ out_free_thread:
+	kfree(new);
+ out_free_handler:
+	kfree(handler);
+ out_fail:
+	return ERR_PTR(r);
+}
+
+/* Undo create_handler, for a handler that never served a call */
+static void destroy_handler(struct ipc_handler *handler)
+{
+	struct thread *thread = handler->thread;
+	struct ipc_vm_config *vm_config = &handler->server->vm_config;
+
+	if (vm_config->grant_size)
+		vmspace_unmap_range(thread->vmspace, handler->grant_addr,
+				    vm_config->grant_size);
+	vmspace_unmap_range(thread->vmspace,
+			    handler->stack_top - vm_config->stack_size,
+			    vm_config->stack_size);
+	pmo_deinit(handler->stack_pmo);
+	kfree(handler->stack_pmo);
+	sched_stat_unregister(thread);
+	destroy_thread_ctx(thread);
+	kfree(thread);
+	kfree(handler);
+}
+
+/*
+ * Take an idle handler thread of the server for a call.
+ * Returns NULL if all of them are serving calls.
+ */
+struct ipc_handler *ipc_get_handler(struct server_ipc_config *server)
+{
+	struct ipc_handler *handler;
+
+	if (list_empty(&server->idle_handlers))
+		return NULL;
+	handler = list_entry(server->idle_handlers.next, struct ipc_handler,
+			     node);
+	list_del(&handler->node);
+	list_append(&handler->node, &server->busy_handlers);
+	return handler;
+}
+
+/* Keep the callers waiting for a handler sorted, highest priority first */
+static void ipc_enqueue_waiter(struct server_ipc_config *server,
+			       struct thread *thread)
+{
+	struct thread *iter;
+	u32 prio = thread->thread_ctx->prio;
+
+	for_each_in_list(iter, struct thread, notification_queue_node,
+			 &server->handler_waiters) {
+		if (iter->thread_ctx->prio < prio) {
+			/* Insert before iter */
+			list_append(&thread->notification_queue_node,
+				    &iter->notification_queue_node);
+			return;
+		}
+	}
+	list_append(&thread->notification_queue_node,
+		    &server->handler_waiters);
+}
+
+/*
+ * Priority inheritance: the busy handlers of a server hold up its waiters,
+ * so they run at least at the priority of the most urgent one. A boosted
+ * handler itself waiting in a nested call moves up in that queue and
+ * boosts the handlers there in turn. Priorities only go up, so this ends
+ * even if calls form a cycle.
+ */
+static void ipc_boost_handlers(struct server_ipc_config *server, u32 prio)
+{
+	struct ipc_handler *handler;
+	struct thread *thread;
+
+	for_each_in_list(handler, struct ipc_handler, node,
+			 &server->busy_handlers) {
+		thread = handler->thread;
+		if (thread->thread_ctx->prio >= prio)
+			continue;
+		thread->thread_ctx->prio = prio;
+		if (handler->waiting) {
+			list_del(&thread->notification_queue_node);
+			ipc_enqueue_waiter(handler->waiting, thread);
+			ipc_boost_handlers(handler->waiting, prio);
+		}
+	}
+}
+
+/*
+ * The call of the handler is over: it goes back to the pool and a caller
+ * waiting for one retries. We still run on the stack of the handler, the
+ * big kernel lock keeps other CPUs from taking it before we leave.
+ */
+void ipc_put_handler(struct ipc_handler *handler)
+{
+	struct server_ipc_config *server = handler->server;
+	struct thread *waiter;
+
+	ipc_grant_unmap(handler);
+	if (handler->conn) {
+		/* The server exited during the call, see ipc_server_exit */
+		if (--handler->conn->calls == 0 && !handler->conn->target)
+			ipc_conn_teardown(handler->conn);
+		obj_put(handler->conn);
+	}
+	handler->conn = NULL;
+	handler->caller = NULL;
+	/* Give back the donated scheduling context and priority */
+	handler->thread->thread_ctx->sc = NULL;
+	handler->thread->thread_ctx->prio = SHADOW_THREAD_PRIO;
+	handler->thread->thread_ctx->state = TS_WAITING;
+	list_del(&handler->node);
+	list_add(&handler->node, &server->idle_handlers);
+
+	/* The most urgent waiter retries */
+	if (!list_empty(&server->handler_waiters)) {
+		waiter = list_entry(server->handler_waiters.next,
+				    struct thread, notification_queue_node);
+		list_del(&waiter->notification_queue_node);
+		init_list_head(&waiter->notification_queue_node);
+		if (waiter->ipc_handler)
+			waiter->ipc_handler->waiting = NULL;
+		BUG_ON(sched_enqueue(waiter));
+	}
+}
+
+/*
+ * No idle handler thread: block until one is put back, then restart the
+ * IPC syscall from the svc instruction. The arguments are still in the
+ * saved context. Never returns.
+ */
+void ipc_wait_handler(struct server_ipc_config *server)
+{
+	struct thread *thread = current_thread;
+
+	thread->thread_ctx->ec.reg[ELR_EL1] -= SVC_INSN_SIZE;
+	sched_charge_budget(thread->thread_ctx->sc, 0);
+	thread->thread_ctx->state = TS_WAITING;
+	ipc_enqueue_waiter(server, thread);
+	if (thread->ipc_handler)
+		thread->ipc_handler->waiting = server;
+	ipc_boost_handlers(server, thread->thread_ctx->prio);
+	current_thread = NULL;
+
+	sched();
+	eret_to_thread(switch_context());
+}
+
+/*
+ * Hand the CPU over to target, the other end of a call or return, which
+ * continues it while the current thread waits. Returns the context to
+ * eret to. target runs right here, unless its affinity, or cpuid for a
+ * thread without one, is another CPU: then it is queued there (with an
+ * IPI) and we schedule something else.
+ */
+u64 ipc_switch_to(struct thread *target, u32 cpuid)
+{
+	if (target->thread_ctx->affinity != NO_AFF)
+		cpuid = target->thread_ctx->affinity;
+
+	if (likely(cpuid == smp_get_cpu_id())) {
+		switch_to_thread(target);
+		return switch_context();
+	}
+
+	/* Charge the donated budget up to the handoff */
+	sched_charge_budget(target->thread_ctx->sc, 0);
+	BUG_ON(sched_enqueue_cpu(target, cpuid));
+	current_thread = NULL;
+	sched();
+	return switch_context();
+}
+
+/* Whether [a, a + a_len) and [b, b + b_len) intersect */
+static bool ranges_overlap(u64 a, u64 a_len, u64 b, u64 b_len)
+{
+	return a < b + b_len && b < a + a_len;
+}
+
+/*
+ * The stacks, the grant windows and the buffer slots (the first ones,
+ * before the bitmap grows) of the handlers must not overlap.
+ */
+static bool vm_config_overlaps(struct ipc_vm_config *vm_config,
+			       u64 handler_num)
+{
+	u64 stack_len = vm_config->stack_size * handler_num;
+	u64 grant_len = vm_config->grant_size * handler_num;
+	u64 buf_len = vm_config->buf_size * BITS_PER_LONG;
+
+	if (ranges_overlap(vm_config->stack_base_addr, stack_len,
+			   vm_config->buf_base_addr, buf_len))
+		return true;
+	if (!grant_len)
+		return false;
+	return ranges_overlap(vm_config->grant_base_addr, grant_len,
+			      vm_config->stack_base_addr, stack_len) ||
+	    ranges_overlap(vm_config->grant_base_addr, grant_len,
+			   vm_config->buf_base_addr, buf_len);
+}
 
 /**
  * The core function for registering the server
  */
-static int register_server(struct thread *server, u64 callback, u64 max_client,
-			   u64 vm_config_ptr)
+static int register_server(struct thread *server, u64 callback,
+			   u64 handler_num, u64 vm_config_ptr,
+			   s32 dispatch_cpu)
 {
 	int r;
+	u64 i;
 	struct server_ipc_config *server_ipc_config;
 	struct ipc_vm_config *vm_config;
+	struct ipc_handler *handler;
 	BUG_ON(server == NULL);
 
+	if (handler_num == 0 || handler_num > IPC_MAX_HANDLER_THREADS ||
+	    (dispatch_cpu != NO_AFF &&
+	     (dispatch_cpu < 0 || dispatch_cpu >= PLAT_CPU_NUM))) {
+		r = -EINVAL;
+		goto out_fail;
+	}
+
 	// Create the server ipc_config
-	server_ipc_config = kmalloc(sizeof(struct server_ipc_config));
+	server_ipc_config = kzalloc(sizeof(struct server_ipc_config));
 	if (!server_ipc_config) {
 		r = -ENOMEM;
 		goto out_fail;
 	}
-	server->server_ipc_config = server_ipc_config;
 
 	// Init the server ipc_config
 	server_ipc_config->callback = callback;
-	if (max_client > IPC_MAX_CONN_PER_SERVER) {
-		r = -EINVAL;
-		goto out_free_server_ipc_config;
-	}
-	server_ipc_config->max_client = max_client;
+	server_ipc_config->dispatch_cpu = dispatch_cpu;
+	init_list_head(&server_ipc_config->idle_handlers);
+	init_list_head(&server_ipc_config->busy_handlers);
+	init_list_head(&server_ipc_config->handler_waiters);
+	init_list_head(&server_ipc_config->conns);
+	server_ipc_config->conn_bmp_size = BITS_PER_LONG;
 	server_ipc_config->conn_bmp =
-	    kzalloc(BITS_TO_LONGS(max_client) * sizeof(long));
+	    kzalloc(BITS_TO_LONGS(server_ipc_config->conn_bmp_size) *
+		    sizeof(long));
 	if (!server_ipc_config->conn_bmp) {
 		r = -ENOMEM;
 		goto out_free_server_ipc_config;
@@ -64,7 +377,7 @@ static int register_server(struct thread *server, u64 callback, u64 max_client,
 	if (r < 0)
 		goto out_free_conn_bmp;
 	if (!is_user_addr_range(vm_config->stack_base_addr,
-				vm_config->stack_size) ||
+				vm_config->stack_size * handler_num) ||
 	    !is_user_addr_range(vm_config->buf_base_addr,
 				vm_config->buf_size) ||
 	    !IS_ALIGNED(vm_config->stack_base_addr, PAGE_SIZE) ||
@@ -74,9 +387,49 @@ static int register_server(struct thread *server, u64 callback, u64 max_client,
 		r = -EINVAL;
 		goto out_free_conn_bmp;
 	}
+	if (vm_config->grant_size &&
+	    (!is_user_addr_range(vm_config->grant_base_addr,
+				 vm_config->grant_size * handler_num) ||
+	     !IS_ALIGNED(vm_config->grant_base_addr, PAGE_SIZE) ||
+	     !IS_ALIGNED(vm_config->grant_size, PAGE_SIZE))) {
+		r = -EINVAL;
+		goto out_free_conn_bmp;
+	}
+	if (vm_config_overlaps(vm_config, handler_num)) {
+		r = -EINVAL;
+		goto out_free_conn_bmp;
+	}
+	pmo_init(&server_ipc_config->grant_pmo, PMO_GRANT,
+		 vm_config->grant_size, 0);
+	server->server_ipc_config = server_ipc_config;
 
-	return r;
+	/*
+	 * Handler threads are never freed. They are not on the thread list
+	 * of the process and thread_deinit does not know about them, so the
+	 * pool, its stacks and server_ipc_config are leaked when the server
+	 * goes away, and nothing keeps process_exit from running while a
+	 * handler still serves a call.
+	 */
+	for (i = 0; i < handler_num; i++) {
+		handler = create_handler(server, i);
+		if (IS_ERR(handler)) {
+			r = PTR_ERR(handler);
+			goto out_destroy_handlers;
+		}
+		list_append(&handler->node, &server_ipc_config->idle_handlers);
+		server_ipc_config->handler_num++;
+	}
+
+	return 0;
 
+ out_destroy_handlers:
+	while (!list_empty(&server_ipc_config->idle_handlers)) {
+		handler = list_entry(server_ipc_config->idle_handlers.next,
+				     struct ipc_handler, node);
+		list_del(&handler->node);
+		destroy_handler(handler);
+	}
+	server->server_ipc_config = NULL;
  out_free_conn_bmp:
 	kfree(server_ipc_config->conn_bmp);
  out_free_server_ipc_config:
@@ -85,8 +438,16 @@ static int register_server(struct thread *server, u64 callback, u64 max_client,
 	return r;
 }
 
-u64 sys_register_server(u64 callback, u64 max_client, u64 vm_config_ptr)
+/*
+ * handler_num is how many calls the server serves at the same time, the
+ * number of connections is not limited. dispatch_cpu chooses where they
+ * run: NO_AFF on the CPU of each caller, for cache locality with it and
+ * parallelism across callers, or a CPU of its own for the server, which
+ * keeps its working set warm there at the price of a cross-CPU handoff.
+ */
+u64 sys_register_server(u64 callback, u64 handler_num, u64 vm_config_ptr,
+			u64 dispatch_cpu)
 {
-	return register_server(current_thread, callback, max_client,
-			       vm_config_ptr);
+	return register_server(current_thread, callback, handler_num,
+			       vm_config_ptr, (s32)dispatch_cpu);
 }
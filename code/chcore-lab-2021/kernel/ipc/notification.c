@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+#include <common/errno.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <ipc/notification.h>
+#include <exception/exception.h>
+#include <process/capability.h>
+#include <process/thread.h>
+#include <sched/context.h>
+#include <sched/sched.h>
+#include <sched/timer_wheel.h>
+
+void notification_init(struct notification *notifc)
+{
+	notifc->not_delivered_notifc_count = 0;
+	init_list_head(&notifc->waiting_threads);
+}
+
+/*
+ * Called when the last cap to the notification is freed.
+ * Threads still blocked on it are woken up with an error.
+ */
+void notification_deinit(void *ptr)
+{
+	struct notification *notifc = ptr;
+	struct thread *thread;
+
+	while (!list_empty(&notifc->waiting_threads)) {
+		thread = list_entry(notifc->waiting_threads.next,
+				    struct thread, notification_queue_node);
+		sched_wakeup(thread, -ECAPBILITY);
+	}
+}
+
+int sys_create_notifc(void)
+{
+	struct notification *notifc;
+	int cap, r;
+
+	notifc = obj_alloc(TYPE_NOTIFICATION, sizeof(*notifc));
+	if (!notifc) {
+		r = -ENOMEM;
+		goto out_fail;
+	}
+	notification_init(notifc);
+
+	cap = cap_alloc(current_process, notifc, 0);
+	if (cap < 0) {
+		r = cap;
+		goto out_free_obj;
+	}
+
+	return cap;
+ out_free_obj:
+	obj_free(notifc);
+ out_fail:
+	return r;
+}
+
+/*
+ * Consume one signal of the notification.
+ * Without a pending signal, fail with -EAGAIN if !is_block, otherwise
+ * block until it is notified (return 0) or until `timeout_us` (0 means
+ * forever) expires (return -ETIME).
+ * The reference on `obj`, the object holding notifc, is put before
+ * blocking.
+ */
+int notification_wait(struct notification *notifc, void *obj, bool is_block,
+		      u64 timeout_us)
+{
+	struct thread *thread = current_thread;
+
+	if (notifc->not_delivered_notifc_count > 0) {
+		notifc->not_delivered_notifc_count--;
+		obj_put(obj);
+		return 0;
+	}
+
+	if (!is_block) {
+		obj_put(obj);
+		return -EAGAIN;
+	}
+
+	sched_charge_budget(thread->thread_ctx->sc, 0);
+	list_append(&thread->notification_queue_node,
+		    &notifc->waiting_threads);
+	arch_set_thread_return(thread, -ETIME);
+	thread->thread_ctx->state = TS_WAITING;
+	if (timeout_us != 0)
+		wheel_timer_add(&thread->wait_timer,
+				DIV_ROUND_UP(timeout_us, TICK_US));
+	/*
+	 * The cap keeps the object alive; if it goes away while we wait,
+	 * its deinit wakes us up.
+	 */
+	obj_put(obj);
+	current_thread = NULL;
+
+	sched();
+	eret_to_thread(switch_context());
+	/* Never returns */
+	return 0;
+}
+
+/* Wake up the first waiter, or record the signal if there is none */
+void notification_notify(struct notification *notifc)
+{
+	struct thread *thread;
+
+	if (list_empty(&notifc->waiting_threads)) {
+		notifc->not_delivered_notifc_count++;
+	} else {
+		thread = list_entry(notifc->waiting_threads.next,
+				    struct thread, notification_queue_node);
+		sched_wakeup(thread, 0);
+	}
+}
+
+int sys_wait(u32 notifc_cap, bool is_block, u64 timeout_us)
+{
+	struct notification *notifc;
+
+	notifc = obj_get(current_process, notifc_cap, TYPE_NOTIFICATION);
+	if (!notifc)
+		return -ECAPBILITY;
+
+	return notification_wait(notifc, notifc, is_block, timeout_us);
+}
+
+int sys_notify(u32 notifc_cap)
+{
+	struct notification *notifc;
+
+	notifc = obj_get(current_process, notifc_cap, TYPE_NOTIFICATION);
+	if (!notifc)
+		return -ECAPBILITY;
+
+	notification_notify(notifc);
+	obj_put(notifc);
+	return 0;
+}
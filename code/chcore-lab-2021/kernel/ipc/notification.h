@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+/* Notification: asynchronous, counting signal between threads/processes */
+#pragma once
+
+#include <common/types.h>
+#include <common/list.h>
+
+struct notification {
+	/* Signals not consumed by any waiter yet */
+	u32 not_delivered_notifc_count;
+	/* Threads blocked in sys_wait, linked by notification_queue_node */
+	struct list_head waiting_threads;
+};
+
+void notification_init(struct notification *notifc);
+void notification_deinit(void *ptr);
+int notification_wait(struct notification *notifc, void *obj, bool is_block,
+		      u64 timeout_us);
+void notification_notify(struct notification *notifc);
+
+/* syscall related to notification */
+int sys_create_notifc(void);
+int sys_wait(u32 notifc_cap, bool is_block, u64 timeout_us);
+int sys_notify(u32 notifc_cap);
@@ -18,6 +18,7 @@
 #include <common/smp.h>
 #include <common/uart.h>
 #include <common/vars.h>
+#include <common/cpufeature.h>
 #include <exception/exception.h>
 #include <ipc/ipc.h>
 #include <common/types.h>
@@ -44,10 +45,15 @@ void stack_test(long x)
 
 void main(void *addr)
 {
+	init_per_cpu_info(0);
+
 	/* Init uart */
 	uart_init();
 	kinfo("[ChCore] uart init finished\n");
 
+	/* Select the atomic instructions before anything takes a lock */
+	cpu_features_init();
+
 	kinfo("Address of main() is 0x%lx\n", main);
 	kinfo("123456 decimal is 0%o octal\n", 123456);
 
@@ -108,9 +114,11 @@ void main(void *addr)
 	BUG("[FATAL] Should never be here!\n");
 }
 
-void secondary_start(void)
+void secondary_start(u32 cpuid)
 {
+	init_per_cpu_info(cpuid);
 	kinfo("AP %u is activated!\n", smp_get_cpu_id());
+	cpu_features_check();
 	exception_init_per_cpu();
 
 	/** 
@@ -24,6 +24,8 @@ void init_buddy(struct phys_mem_pool *pool, struct page *start_page,
 	/* This field is for unit test only. */
 	pool->pool_phys_page_num = page_num;
 
+	lock_init(&pool->buddy_lock);
+
 	/* Init the free lists */
 	for (order = 0; order < BUDDY_MAX_ORDER; ++order) {
 		pool->free_lists[order].nr_free = 0;
@@ -142,7 +144,8 @@ static struct page *split_page(struct phys_mem_pool *pool, u64 order,
  * Hints: Find the corresonding free_list which can allocate 1<<order
  * continuous pages and don't forget to split the list node after allocation   
  */
-struct page *buddy_get_pages(struct phys_mem_pool *pool, u64 order)
+static struct page *_buddy_get_pages_nolock(struct phys_mem_pool *pool,
+					    u64 order)
 {
 	// kdebug("buddy_get_pages\n");
 	// <lab2>
@@ -182,6 +185,16 @@ struct page *buddy_get_pages(struct phys_mem_pool *pool, u64 order)
 	// </lab2>
 }
 
+struct page *buddy_get_pages(struct phys_mem_pool *pool, u64 order)
+{
+	struct page *page;
+
+	lock(&pool->buddy_lock);
+	page = _buddy_get_pages_nolock(pool, order);
+	unlock(&pool->buddy_lock);
+	return page;
+}
+
 /*
  * merge_page: merge the given page with the buddy page
  * pool @ physical memory structure reserved in the kernel
@@ -243,12 +256,14 @@ static struct page *merge_page(struct phys_mem_pool *pool, struct page *page)
 void buddy_free_pages(struct phys_mem_pool *pool, struct page *page)
 {
 	// <lab2>
+	lock(&pool->buddy_lock);
 	page -> allocated = 0;
 	struct free_list* origin_free_list = &(pool->free_lists[page->order]);
 	origin_free_list->nr_free++;
 	list_add(&page->node, &origin_free_list->free_list);
 
 	merge_page(pool, page);
+	unlock(&pool->buddy_lock);
 	// </lab2>
 }
 
@@ -2,6 +2,7 @@
 
 #include <common/types.h>
 #include <common/list.h>
+#include <common/lock.h>
 
 /*
  * Supported Order: [0, BUDDY_MAX_ORDER).
@@ -51,6 +52,9 @@ struct phys_mem_pool {
 
 	/* The free list of different free-memory-chunk orders. */
 	struct free_list free_lists[BUDDY_MAX_ORDER];
+
+	/* Protects the free lists and the page metadata. */
+	struct lock buddy_lock;
 };
 
 /* Currently, ChCore only uses one physical memory pool. */
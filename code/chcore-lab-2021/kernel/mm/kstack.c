@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#include <common/mm.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <common/lock.h>
+#include <common/smp.h>
+#include <common/sync.h>
+#include <common/errno.h>
+#include <common/kmalloc.h>
+
+#include "kstack.h"
+#include "page_table.h"
+
+extern int get_next_ptp(ptp_t *cur_ptp, u32 level, vaddr_t va, ptp_t **next_ptp, pte_t **pte, bool alloc);
+extern unsigned long get_ttbr1(void);
+
+/*
+ * Stacks are never unmapped: a freed one goes to the cache of the CPU
+ * freeing it, or to the global free list, linked through its first word.
+ */
+static struct lock kstack_lock;
+static void *kstack_free_list;
+static u64 kstack_next_slot;
+
+void kstack_init(void)
+{
+	lock_init(&kstack_lock);
+	kstack_free_list = NULL;
+	kstack_next_slot = 0;
+}
+
+/* Back the stack page of a new slot, called with kstack_lock held */
+static int kstack_map(vaddr_t va)
+{
+	ptp_t *ptp = (ptp_t *)phys_to_virt(get_ttbr1());
+	pte_t *pte;
+	void *page;
+	u32 level;
+	int ret;
+
+	for (level = 0; level < 3; level++) {
+		ret = get_next_ptp(ptp, level, va, &ptp, &pte, true);
+		if (ret < 0)
+			return ret;
+	}
+
+	page = get_pages(0);
+	if (page == NULL)
+		return -ENOMEM;
+
+	pte = &ptp->ent[GET_L3_INDEX(va)];
+	pte->pte = 0;
+	pte->l3_page.is_valid = 1;
+	pte->l3_page.is_page = 1;
+	pte->l3_page.attr_index = NORMAL_MEMORY;
+	pte->l3_page.SH = INNER_SHAREABLE;
+	pte->l3_page.AF = AARCH64_PTE_AF_ACCESSED;
+	pte->l3_page.UXN = AARCH64_PTE_UXN;
+	pte->l3_page.PXN = AARCH64_PTE_PXN;
+	pte->l3_page.pfn = virt_to_phys((vaddr_t)page) >> PAGE_SHIFT;
+
+	/* The entry was invalid before, so there is nothing to flush */
+	dsb(ishst);
+	isb();
+	return 0;
+}
+
+static void *kstack_alloc_global(void)
+{
+	void *stack = NULL;
+	vaddr_t va;
+
+	lock(&kstack_lock);
+	if (kstack_free_list) {
+		stack = kstack_free_list;
+		kstack_free_list = *(void **)stack;
+	} else if (kstack_next_slot < KSTACK_SLOT_NUM) {
+		va = KSTACK_BASE + kstack_next_slot * KSTACK_SLOT_SIZE +
+		    KSTACK_SIZE;
+		if (kstack_map(va) == 0) {
+			stack = (void *)va;
+			kstack_next_slot++;
+		}
+	}
+	unlock(&kstack_lock);
+	return stack;
+}
+
+/* Returns the lowest address of a KSTACK_SIZE stack, its content is stale */
+void *kstack_alloc(void)
+{
+	struct per_cpu_info *info = get_per_cpu_info();
+
+	if (info->kstack_cache_nr > 0)
+		return info->kstack_cache[--info->kstack_cache_nr];
+	return kstack_alloc_global();
+}
+
+/*
+ * A thread exiting frees the stack it is running on, so the stack just
+ * freed stays in the cache of this CPU and only the older ones are handed
+ * to other CPUs. Nothing on this CPU allocates a stack before it switches
+ * away. The kernel runs with IRQs masked, so the cache needs no lock.
+ */
+void kstack_free(void *stack)
+{
+	struct per_cpu_info *info = get_per_cpu_info();
+	u32 i, half = KSTACK_CACHE_NUM / 2;
+
+	BUG_ON((vaddr_t)stack < KSTACK_BASE ||
+	       (vaddr_t)stack >= KSTACK_BASE + KSTACK_SLOT_NUM *
+	       KSTACK_SLOT_SIZE);
+
+	if (info->kstack_cache_nr == KSTACK_CACHE_NUM) {
+		lock(&kstack_lock);
+		for (i = 0; i < half; i++) {
+			*(void **)info->kstack_cache[i] = kstack_free_list;
+			kstack_free_list = info->kstack_cache[i];
+		}
+		unlock(&kstack_lock);
+		for (i = half; i < KSTACK_CACHE_NUM; i++)
+			info->kstack_cache[i - half] = info->kstack_cache[i];
+		info->kstack_cache_nr -= half;
+	}
+	info->kstack_cache[info->kstack_cache_nr++] = stack;
+}
+
+/* Called on the boot stack of the CPU when sp ran into a guard page */
+void kstack_overflow(u64 sp, u64 far, u64 elr)
+{
+	kinfo("kernel stack overflow: sp 0x%lx far 0x%lx elr 0x%lx\n",
+	      sp, far, elr);
+	BUG("kernel stack overflow");
+}
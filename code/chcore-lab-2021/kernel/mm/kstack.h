@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#pragma once
+
+#include <common/vars.h>
+
+/*
+ * Kernel stacks live in their own region of the kernel address space.
+ * Each slot is a guard page, left unmapped, followed by one page of stack,
+ * so an overflow faults instead of running into the neighbouring memory.
+ * The region is [KBASE + 4G, KBASE + 8G): bit 32 of an address tells
+ * whether it is in there and bit 12 whether it is in a guard page.
+ */
+#define KSTACK_BASE		(KBASE + 0x100000000UL)
+#define KSTACK_REGION_BIT	32
+#define KSTACK_GUARD_BIT	12
+#define KSTACK_SIZE		(0x1000)
+#define KSTACK_SLOT_SIZE	(2 * KSTACK_SIZE)
+#define KSTACK_SLOT_NUM		4096
+
+/* Freed stacks kept by each CPU before going back to the global pool */
+#define KSTACK_CACHE_NUM	8
+
+#ifndef __ASM__
+#include <common/types.h>
+
+void kstack_init(void);
+void *kstack_alloc(void);
+void kstack_free(void *stack);
+void kstack_overflow(u64 sp, u64 far, u64 elr);
+#endif
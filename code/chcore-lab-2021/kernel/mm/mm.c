@@ -17,6 +17,7 @@
 #include "buddy.h"
 #include "slab.h"
 #include "page_table.h"
+#include "kstack.h"
 
 extern int get_next_ptp(ptp_t *cur_ptp, u32 level, vaddr_t va, ptp_t **next_ptp, pte_t **pte, bool alloc);
 extern unsigned long *img_end;
@@ -137,6 +138,9 @@ void mm_init(void)
 	init_slab();
 
 	map_kernel_space(KBASE + (128UL << 21), 128UL << 21, 128UL << 21);
+
+	/* guard-paged kernel stacks, needed from sched_init on */
+	kstack_init();
 	//check whether kernel space [KABSE + 256 : KBASE + 512] is mapped 
 	// kernel_space_check();
 }
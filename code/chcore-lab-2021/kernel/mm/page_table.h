@@ -126,3 +126,5 @@ typedef union {
 typedef struct {
 	pte_t ent[PTP_ENTRIES];
 } ptp_t;
+
+int query_in_pgtbl(vaddr_t * pgtbl, vaddr_t va, paddr_t * pa, pte_t ** entry);
@@ -349,6 +349,8 @@ u64 sys_handle_brk(u64 addr)
 	// int ret;
 
 	vmspace = obj_get(current_process, VMSPACE_OBJ_ID, TYPE_VMSPACE);
+	/* serialize heap updates against other threads of the process */
+	write_lock(&vmspace->vmr_lock);
 
 	/*
 	 * Lab3: Your code here
@@ -407,7 +409,7 @@ u64 sys_handle_brk(u64 addr)
 
 		vmspace->heap_vmr = vmr;
 		retval = vmspace->user_current_heap;
-		return retval;
+		goto error;
 	}
 
 	if (addr >= (vmspace->user_current_heap + vmspace->heap_vmr->size))
@@ -426,6 +428,7 @@ u64 sys_handle_brk(u64 addr)
 	}
 
 error:
+	write_unlock(&vmspace->vmr_lock);
 	obj_put(vmspace);
 	return retval;
 }
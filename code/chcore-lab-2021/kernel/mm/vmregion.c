@@ -19,6 +19,7 @@
 #include <common/kmalloc.h>
 #include <common/mm.h>
 #include <common/mmu.h>
+#include <common/sync.h>
 
 /* local functions */
 
@@ -86,6 +87,7 @@ static void del_vmr_from_vmspace(struct vmspace *vmspace, struct vmregion *vmr)
 	free_vmregion(vmr);
 }
 
+/* Caller should hold vmspace->vmr_lock */
 struct vmregion *find_vmr_for_va(struct vmspace *vmspace, vaddr_t addr)
 {
 	struct vmregion *vmr;
@@ -136,23 +138,31 @@ int vmspace_map_range(struct vmspace *vmspace, vaddr_t va, size_t len,
 	vmr->perm = flags;
 	vmr->pmo = pmo;
 
+	write_lock(&vmspace->vmr_lock);
 	ret = add_vmr_to_vmspace(vmspace, vmr);
 
 	if (ret < 0)
-		goto out_free_vmr;
+		goto out_unlock;
 	BUG_ON((pmo->type != PMO_DATA) &&
 	       (pmo->type != PMO_ANONYM) &&
-	       (pmo->type != PMO_DEVICE) && (pmo->type != PMO_SHM));
+	       (pmo->type != PMO_DEVICE) && (pmo->type != PMO_SHM) &&
+	       (pmo->type != PMO_GRANT));
 	/* on-demand mapping for anonymous mapping */
-	if (pmo->type == PMO_DATA)
+	if (pmo->type == PMO_DATA) {
+		lock(&vmspace->pgtbl_lock);
 		fill_page_table(vmspace, vmr);
+		unlock(&vmspace->pgtbl_lock);
+	}
+	write_unlock(&vmspace->vmr_lock);
 	return 0;
- out_free_vmr:
+ out_unlock:
+	write_unlock(&vmspace->vmr_lock);
 	free_vmregion(vmr);
  out_fail:
 	return ret;
 }
 
+/* Caller should hold vmspace->vmr_lock for write */
 struct vmregion *init_heap_vmr(struct vmspace *vmspace, vaddr_t va,
 			       struct pmobject *pmo)
 {
@@ -188,9 +198,12 @@ int vmspace_unmap_range(struct vmspace *vmspace, vaddr_t va, size_t len)
 	vaddr_t start;
 	size_t size;
 
+	write_lock(&vmspace->vmr_lock);
 	vmr = find_vmr_for_va(vmspace, va);
-	if (!vmr)
+	if (!vmr) {
+		write_unlock(&vmspace->vmr_lock);
 		return -1;
+	}
 	start = vmr->start;
 	size = vmr->size;
 
@@ -201,7 +214,10 @@ int vmspace_unmap_range(struct vmspace *vmspace, vaddr_t va, size_t len)
 
 	del_vmr_from_vmspace(vmspace, vmr);
 
+	lock(&vmspace->pgtbl_lock);
 	unmap_range_in_pgtbl(vmspace->pgtbl, va, len);
+	unlock(&vmspace->pgtbl_lock);
+	write_unlock(&vmspace->vmr_lock);
 
 	return 0;
 }
@@ -210,6 +226,8 @@ int vmspace_unmap_range(struct vmspace *vmspace, vaddr_t va, size_t len)
 
 int vmspace_init(struct vmspace *vmspace)
 {
+	rwlock_init(&vmspace->vmr_lock);
+	lock_init(&vmspace->pgtbl_lock);
 	init_list_head(&vmspace->vmr_list);
 	/* alloc the root page table page */
 	vmspace->pgtbl = get_pages(0);
@@ -241,6 +259,12 @@ int destroy_vmspace(struct vmspace *vmspace)
 	return 0;
 }
 
+/* Pages committed to a lazy pmobject go back to the buddy system with it */
+static void pmo_free_page(void *pa)
+{
+	free_pages((void *)phys_to_virt((paddr_t)pa));
+}
+
 /*
  * @paddr is only useful when @type == PMO_DEVICE.
  */
@@ -259,13 +283,46 @@ void pmo_init(struct pmobject *pmo, pmo_type_t type, size_t len, paddr_t paddr)
 		pmo->start = (paddr_t) virt_to_phys(kmalloc(len));
 	} else if (type == PMO_DEVICE) {
 		pmo->start = paddr;
-	} else {
+	} else if (type != PMO_GRANT) {
 		/*
 		 * for stack, heap, we do not allocate the physical memory at
 		 * once
 		 */
 		pmo->radix = new_radix();
-		init_radix(pmo->radix);
+		init_radix_w_deleter(pmo->radix, pmo_free_page);
+	}
+}
+
+/*
+ * Release the physical memory of a pmobject, which must not be mapped
+ * any more. The pmobject itself belongs to the caller.
+ */
+void pmo_deinit(struct pmobject *pmo)
+{
+	if (pmo->type == PMO_DATA) {
+		kfree((void *)phys_to_virt(pmo->start));
+	} else if (pmo->type != PMO_DEVICE && pmo->type != PMO_GRANT) {
+		radix_free(pmo->radix);
+		kfree(pmo->radix);
+	}
+}
+
+/* Take a reference on a counted pmobject, no-op for the others */
+void pmo_get(struct pmobject *pmo)
+{
+	if (pmo->refcnt)
+		atomic_fetch_add_64(&pmo->refcnt, 1);
+}
+
+/*
+ * Drop a reference on a counted pmobject, the last one releases its
+ * memory and frees it (it must come from kmalloc).
+ */
+void pmo_put(struct pmobject *pmo)
+{
+	if (pmo->refcnt && atomic_fetch_sub_64(&pmo->refcnt, 1) == 1) {
+		pmo_deinit(pmo);
+		kfree(pmo);
 	}
 }
 
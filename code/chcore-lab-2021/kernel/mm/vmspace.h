@@ -14,6 +14,7 @@
 
 #include <common/list.h>
 #include <common/mmu.h>
+#include <common/rwlock.h>
 
 #include <common/radix.h>
 
@@ -29,6 +30,10 @@ struct vmregion {
 };
 
 struct vmspace {
+	/* protects vmr_list and the heap, lookups only take it for read */
+	struct rwlock vmr_lock;
+	/* serializes page table updates */
+	struct lock pgtbl_lock;
 	/* list of vmregion */
 	struct list_head vmr_list;
 	/* root page table */
@@ -45,13 +50,24 @@ typedef u64 pmo_type_t;
 #define PMO_SHM        3	/* shared memory */
 #define PMO_USER_PAGER 4	/* support user pager */
 #define PMO_DEVICE     5	/* memory mapped device registers */
+#define PMO_GRANT      6	/* reserved, only mapped by the kernel (IPC grants) */
 
 struct pmobject {
 	struct radix *radix;	/* record physical pages */
 	paddr_t start;
 	size_t size;
 	pmo_type_t type;
+	/*
+	 * Set to 1 by owners that free the pmobject while other users may
+	 * still hold it, see pmo_put. 0 (as left by pmo_init) means it is not
+	 * counted and lives as long as its owner.
+	 */
 	atomic_cnt refcnt;
+	/*
+	 * Serializes page commits, a lazy PMO may be faulted in from
+	 * several vmspaces at once. Zeroed by pmo_init, which is free.
+	 */
+	struct lock lock;
 
 	// if type == PMO_BACKED
 	struct file_cap *file;
@@ -60,6 +76,9 @@ struct pmobject {
 
 int vmspace_init(struct vmspace *vmspace);
 void pmo_init(struct pmobject *pmo, pmo_type_t type, size_t len, paddr_t paddr);
+void pmo_deinit(struct pmobject *pmo);
+void pmo_get(struct pmobject *pmo);
+void pmo_put(struct pmobject *pmo);
 
 int vmspace_map_range(struct vmspace *vmspace, vaddr_t va, size_t len,
 		      vmr_prop_t flags, struct pmobject *pmo);
@@ -72,5 +91,8 @@ void switch_vmspace_to(struct vmspace *);
 void commit_page_to_pmo(struct pmobject *pmo, u64 index, paddr_t pa);
 paddr_t get_page_from_pmo(struct pmobject *pmo, u64 index);
 
+/* Populate one page of a PMO_ANONYM region, see exception/pgfault.c */
+int handle_trans_fault(struct vmspace *vmspace, vaddr_t fault_addr);
+
 struct vmregion *init_heap_vmr(struct vmspace *vmspace, vaddr_t va,
 			       struct pmobject *pmo);
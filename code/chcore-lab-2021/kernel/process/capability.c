@@ -13,6 +13,8 @@
 #include <process/capability.h>
 #include <process/process.h>
 #include <process/thread.h>
+#include <ipc/ipc.h>
+#include <ipc/notification.h>
 #include <common/kmalloc.h>
 #include <common/uaccess.h>
 #include <common/printk.h>
@@ -20,8 +22,20 @@
 const obj_deinit_func obj_deinit_tbl[TYPE_NR] = {
 	[0 ... TYPE_NR - 1] = NULL,
 	[TYPE_THREAD] = thread_deinit,
+	[TYPE_CONNECTION] = connection_deinit,
+	[TYPE_NOTIFICATION] = notification_deinit,
 };
 
+/*
+ * Protects the copies lists of all objects.
+ * Lock order: slot_table.table_guard (read or write) -> copies_lock.
+ * A zeroed lock is free, so it needs no runtime init.
+ */
+static struct lock copies_lock;
+
+static int __cap_free(struct process *process, int slot_id,
+		      struct object *expected);
+
 /* local object operation methods */
 static void *get_opaque(struct process *process, int slot_id,
 			bool type_valid, int type)
@@ -30,6 +44,7 @@ static void *get_opaque(struct process *process, int slot_id,
 	struct object_slot *slot;
 	void *obj;
 
+	read_lock(&slot_table->table_guard);
 	if (!is_valid_slot_id(slot_table, slot_id)) {
 		obj = NULL;
 		goto out_unlock_table;
@@ -50,6 +65,7 @@ static void *get_opaque(struct process *process, int slot_id,
 
  out_unlock_slot:
  out_unlock_table:
+	read_unlock(&slot_table->table_guard);
 	return obj;
 }
 
@@ -63,12 +79,23 @@ static struct object *__object_get(struct process *process, int slot_id)
 		return container_of(obj, struct object, opaque);
 }
 
+/*
+ * Like __cap_free, the last reference deinits the object: its caps may
+ * all be gone while a reference was held.
+ */
 static void __object_put(struct object *object)
 {
 	u64 old_refcount;
+	obj_deinit_func func;
+
 	old_refcount = atomic_fetch_sub_64(&object->refcount, 1);
-	if (old_refcount == 1)
-		kfree(object);
+	if (old_refcount == 1) {
+		func = obj_deinit_tbl[object->type];
+		if (func)
+			func(object->opaque);
+		if (object->refcount == 0)
+			kfree(object);
+	}
 }
 
 /* object refenrence */
@@ -83,6 +110,25 @@ void obj_put(void *obj)
 	__object_put(object);
 }
 
+/*
+ * Take a reference on an object found by pointer rather than by cap, e.g.
+ * in a table of the kernel which the caller keeps from changing. Returns
+ * NULL if the object is already going away.
+ */
+void *obj_ref(void *obj)
+{
+	struct object *object = container_of(obj, struct object, opaque);
+	u64 refcount;
+
+	do {
+		refcount = object->refcount;
+		if (refcount == 0)
+			return NULL;
+	} while (atomic_compare_exchange_64(&object->refcount, refcount,
+					    refcount + 1) != refcount);
+	return obj;
+}
+
 void *obj_alloc(u64 type, u64 size)
 {
 	u64 total_size;
@@ -114,8 +160,9 @@ void *obj_alloc(u64 type, u64 size)
 void obj_free(void *obj)
 {
 	struct object *object;
-	struct object_slot *slot_iter = NULL, *slot_iter_tmp = NULL;
-	int r;
+	struct object_slot *slot_iter;
+	struct process *iter_process;
+	u64 iter_slot_id;
 
 	if (!obj)
 		return;
@@ -127,14 +174,25 @@ void obj_free(void *obj)
 		return;
 	}
 
-	/* free all copied slots */
-	for_each_in_list_safe(slot_iter, slot_iter_tmp,
-			      copies, &object->copies_head) {
-		u64 iter_slot_id = slot_iter->slot_id;
-		struct process *iter_process = slot_iter->process;
-
-		r = cap_free(iter_process, iter_slot_id);
-		BUG_ON(r != 0);
+	/*
+	 * free all copied slots
+	 * cap_free takes the slot table lock, so the list is walked one
+	 * slot at a time without holding copies_lock across the call. A slot
+	 * freed concurrently by its owner is simply skipped.
+	 */
+	while (true) {
+		lock(&copies_lock);
+		if (list_empty(&object->copies_head)) {
+			unlock(&copies_lock);
+			break;
+		}
+		slot_iter = list_entry(object->copies_head.next,
+				       struct object_slot, copies);
+		iter_slot_id = slot_iter->slot_id;
+		iter_process = slot_iter->process;
+		unlock(&copies_lock);
+
+		__cap_free(iter_process, iter_slot_id, object);
 	}
 }
 
@@ -146,54 +204,73 @@ int cap_alloc(struct process *process, void *obj, u64 rights)
 
 	object = container_of(obj, struct object, opaque);
 
+	slot = kmalloc(sizeof(*slot));
+	if (!slot)
+		return -ENOMEM;
+
+	write_lock(&process->slot_table.table_guard);
 	slot_id = alloc_slot_id(process);
 	if (slot_id < 0) {
 		r = -ENOMEM;
 		goto out_unlock_table;
 	}
 
-	slot = kmalloc(sizeof(*slot));
-	if (!slot) {
-		r = -ENOMEM;
-		goto out_free_slot_id;
-	}
 	slot->slot_id = slot_id;
 	slot->process = process;
 	slot->isvalid = true;
 	slot->rights = rights;
 	slot->object = object;
+	lock(&copies_lock);
 	list_add(&slot->copies, &object->copies_head);
+	unlock(&copies_lock);
 
 	BUG_ON(object->refcount != 0);
 	object->refcount = 1;
 
 	install_slot(process, slot_id, slot);
+	write_unlock(&process->slot_table.table_guard);
 
 	return slot_id;
- out_free_slot_id:
-	free_slot_id(process, slot_id);
  out_unlock_table:
+	write_unlock(&process->slot_table.table_guard);
+	kfree(slot);
 	return r;
 }
 
-int cap_free(struct process *process, int slot_id)
+/*
+ * Free the slot. If `expected` is not NULL, the slot is only freed when it
+ * still points to that object (it may have been reused after a concurrent
+ * cap_free).
+ */
+static int __cap_free(struct process *process, int slot_id,
+		      struct object *expected)
 {
+	struct slot_table *slot_table = &process->slot_table;
 	struct object_slot *slot;
 	struct object *object;
 	int r = 0;
 	u64 old_refcount;
 	obj_deinit_func func;
 
+	write_lock(&slot_table->table_guard);
 	slot = get_slot(process, slot_id);
-	if (!slot || slot->isvalid == false) {
+	if (!slot || slot->isvalid == false ||
+	    (expected && slot->object != expected)) {
 		r = -ECAPBILITY;
 		goto out_unlock_table;
 	}
 
 	free_slot_id(process, slot_id);
+	object = slot->object;
+	slot->isvalid = false;
+	slot->object = NULL;
+	lock(&copies_lock);
+	list_del(&slot->copies);
+	unlock(&copies_lock);
+	write_unlock(&slot_table->table_guard);
 	/* no need to get slot_guard as it can not be accessed */
 
-	object = slot->object;
+	/* the deinit function may block or take other locks */
 	old_refcount = atomic_fetch_sub_64(&object->refcount, 1);
 	if (old_refcount == 1) {
 		func = obj_deinit_tbl[object->type];
@@ -202,56 +279,160 @@ int cap_free(struct process *process, int slot_id)
 		if (object->refcount == 0)
 			kfree(object);
 	}
-
-	slot->isvalid = false;
-	slot->object = NULL;
-	list_del(&slot->copies);
 	kfree(slot);
 
 	return r;
  out_unlock_table:
+	write_unlock(&slot_table->table_guard);
 	return r;
 }
 
+int cap_free(struct process *process, int slot_id)
+{
+	return __cap_free(process, slot_id, NULL);
+}
+
 int cap_copy(struct process *src_process, struct process *dest_process,
 	     int src_slot_id, bool new_rights_valid, u64 new_rights)
 {
 	struct object_slot *src_slot, *dest_slot;
+	struct object *object;
+	u64 rights;
 	int r, dest_slot_id;
 
+	dest_slot = kmalloc(sizeof(*dest_slot));
+	if (!dest_slot)
+		return -ENOMEM;
+
+	/*
+	 * The two tables are locked one after the other, never nested, so
+	 * copies between two processes in both directions cannot deadlock.
+	 * The reference taken here keeps the object alive in between.
+	 */
+	read_lock(&src_process->slot_table.table_guard);
 	src_slot = get_slot(src_process, src_slot_id);
 	if (!src_slot || src_slot->isvalid == false) {
+		read_unlock(&src_process->slot_table.table_guard);
 		r = -ECAPBILITY;
-		goto out_unlock;
+		goto out_free_slot;
 	}
+	object = src_slot->object;
+	rights = src_slot->rights;
+	atomic_fetch_add_64(&object->refcount, 1);
+	read_unlock(&src_process->slot_table.table_guard);
 
+	write_lock(&dest_process->slot_table.table_guard);
 	dest_slot_id = alloc_slot_id(dest_process);
-	if (dest_slot_id == -1) {
+	if (dest_slot_id < 0) {
 		r = -ENOMEM;
 		goto out_unlock;
 	}
 
-	dest_slot = kmalloc(sizeof(*dest_slot));
-	if (!dest_slot) {
-		r = -ENOMEM;
-		goto out_free_slot_id;
-	}
-	src_slot = get_slot(src_process, src_slot_id);
-	atomic_fetch_add_64(&src_slot->object->refcount, 1);
-
 	dest_slot->slot_id = dest_slot_id;
 	dest_slot->process = dest_process;
 	dest_slot->isvalid = true;
-	dest_slot->object = src_slot->object;
-	dest_slot->rights = new_rights_valid ? new_rights : src_slot->rights;
-	list_add(&dest_slot->copies, &src_slot->copies);
+	dest_slot->object = object;
+	dest_slot->rights = new_rights_valid ? new_rights : rights;
+	lock(&copies_lock);
+	list_add(&dest_slot->copies, &object->copies_head);
+	unlock(&copies_lock);
 
 	install_slot(dest_process, dest_slot_id, dest_slot);
+	write_unlock(&dest_process->slot_table.table_guard);
 
 	return dest_slot_id;
- out_free_slot_id:
-	free_slot_id(dest_process, dest_slot_id);
  out_unlock:
+	write_unlock(&dest_process->slot_table.table_guard);
+	__object_put(object);
+ out_free_slot:
+	kfree(dest_slot);
+	return r;
+}
+
+/*
+ * Copy nr caps of src_process to dest_process at once, all or nothing.
+ * slot_ids holds the source slots and gets the new ones in place. The
+ * source table is locked once to take the objects, the destination
+ * table once to allocate and install all the slots.
+ */
+int cap_copy_batch(struct process *src_process, struct process *dest_process,
+		   u64 *slot_ids, int nr)
+{
+	struct object_slot *src_slot, *dest_slots[CAP_COPY_BATCH_MAX];
+	struct object *objects[CAP_COPY_BATCH_MAX];
+	u64 rights[CAP_COPY_BATCH_MAX];
+	int r, i, got = 0, dest_slot_id;
+
+	BUG_ON(nr > CAP_COPY_BATCH_MAX);
+
+	/*
+	 * One allocation per slot: each slot is freed on its own by
+	 * __cap_free, and they are small slab objects anyway. What the
+	 * batch saves is taking each table lock once, and allocating
+	 * them all first keeps kmalloc out of the locked sections.
+	 */
+	for (i = 0; i < nr; i++) {
+		dest_slots[i] = kmalloc(sizeof(*dest_slots[i]));
+		if (!dest_slots[i]) {
+			r = -ENOMEM;
+			goto out_free_slots;
+		}
+	}
+
+	read_lock(&src_process->slot_table.table_guard);
+	for (got = 0; got < nr; got++) {
+		src_slot = get_slot(src_process, slot_ids[got]);
+		if (!src_slot || src_slot->isvalid == false) {
+			read_unlock(&src_process->slot_table.table_guard);
+			r = -ECAPBILITY;
+			goto out_put_objects;
+		}
+		objects[got] = src_slot->object;
+		rights[got] = src_slot->rights;
+		atomic_fetch_add_64(&objects[got]->refcount, 1);
+	}
+	read_unlock(&src_process->slot_table.table_guard);
+
+	write_lock(&dest_process->slot_table.table_guard);
+	for (i = 0; i < nr; i++) {
+		dest_slot_id = alloc_slot_id(dest_process);
+		if (dest_slot_id < 0) {
+			while (--i >= 0)
+				free_slot_id(dest_process,
+					     dest_slots[i]->slot_id);
+			write_unlock(&dest_process->slot_table.table_guard);
+			r = -ENOMEM;
+			goto out_put_objects;
+		}
+		dest_slots[i]->slot_id = dest_slot_id;
+	}
+
+	lock(&copies_lock);
+	for (i = 0; i < nr; i++) {
+		dest_slots[i]->process = dest_process;
+		dest_slots[i]->isvalid = true;
+		dest_slots[i]->object = objects[i];
+		dest_slots[i]->rights = rights[i];
+		list_add(&dest_slots[i]->copies, &objects[i]->copies_head);
+	}
+	unlock(&copies_lock);
+
+	for (i = 0; i < nr; i++) {
+		install_slot(dest_process, dest_slots[i]->slot_id,
+			     dest_slots[i]);
+		slot_ids[i] = dest_slots[i]->slot_id;
+	}
+	write_unlock(&dest_process->slot_table.table_guard);
+
+	return 0;
+
+ out_put_objects:
+	while (--got >= 0)
+		__object_put(objects[got]);
+	i = nr;
+ out_free_slots:
+	while (--i >= 0)
+		kfree(dest_slots[i]);
 	return r;
 }
 
@@ -378,6 +559,7 @@ int sys_get_all_caps(u64 process_cap)
 	printk("thread %p cap:\n", current_thread);
 
 	slot_table = &process->slot_table;
+	read_lock(&slot_table->table_guard);
 	for (i = 0; i < slot_table->slots_size; i++) {
 		struct object_slot *slot = get_slot(process, i);
 		if (!slot)
@@ -386,6 +568,7 @@ int sys_get_all_caps(u64 process_cap)
 		printk("slot_id:%d type:%d\n", i,
 		       slot_table->slots[i]->object->type);
 	}
+	read_unlock(&slot_table->table_guard);
 
 	obj_put(process);
 	return 0;
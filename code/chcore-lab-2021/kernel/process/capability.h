@@ -46,6 +46,7 @@ extern const obj_deinit_func obj_deinit_tbl[TYPE_NR];
 
 void *obj_get(struct process *process, int slot_id, int type);
 void obj_put(void *obj);
+void *obj_ref(void *obj);
 void *obj_alloc(u64 type, u64 size);
 void obj_free(void *obj);
 
@@ -53,6 +54,10 @@ int cap_alloc(struct process *process, void *obj, u64 rights);
 int cap_free(struct process *process, int slot_id);
 int cap_copy(struct process *src_process, struct process *dest_process,
 	     int src_slot_id, bool new_rights_valid, u64 new_rights);
+/* Upper bound of the caps copied by one cap_copy_batch */
+#define CAP_COPY_BATCH_MAX 16
+int cap_copy_batch(struct process *src_process, struct process *dest_process,
+		   u64 *slot_ids, int nr);
 int cap_copy_local(struct process *process, int src_slot_id, u64 new_rights);
 int cap_move(struct process *src_process, struct process *dest_process,
 	     int src_slot_id, bool new_rights_valid, u64 new_rights);
@@ -23,7 +23,7 @@
 /* tool functions */
 bool is_valid_slot_id(struct slot_table * slot_table, int slot_id)
 {
-	if (slot_id < 0 && slot_id >= slot_table->slots_size)
+	if (slot_id < 0 || slot_id >= slot_table->slots_size)
 		return false;
 	if (!get_bit(slot_id, slot_table->slots_bmp))
 		return false;
@@ -140,6 +140,7 @@ static int process_init(struct process *process, unsigned int size)
 	struct slot_table *slot_table = &process->slot_table;
 
 	BUG_ON(slot_table_init(slot_table, size));
+	rwlock_init(&slot_table->table_guard);
 	init_list_head(&process->thread_list);
 
 	return 0;
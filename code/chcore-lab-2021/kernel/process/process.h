@@ -19,6 +19,7 @@
 #include <common/kprint.h>
 #include <common/macro.h>
 #include <common/sync.h>
+#include <common/rwlock.h>
 
 struct object_slot {
 	u64 slot_id;
@@ -44,6 +45,8 @@ struct slot_table {
 	 */
 	unsigned long *full_slots_bmp;
 	unsigned long *slots_bmp;
+	/* protects the fields above, lookups only take it for read */
+	struct rwlock table_guard;
 };
 
 struct process {
@@ -58,6 +61,7 @@ void process_create_root(char *bin_name);
 /*
  * ATTENTION: These interfaces are for capability internal use.
  * As a cap user, check capability.h for interfaces for cap.
+ * Callers should hold process->slot_table.table_guard.
  */
 int alloc_slot_id(struct process *process);
 
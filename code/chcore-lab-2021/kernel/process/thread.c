@@ -24,6 +24,7 @@
 #include <common/smp.h>
 #include <common/cpio.h>
 #include <exception/exception.h>
+#include <ipc/ipc.h>
 
 #include "thread_env.h"
 
@@ -39,6 +40,9 @@ static int thread_init(struct thread *thread, struct process *process,
 	if (!thread->thread_ctx)
 		return -ENOMEM;
 	init_thread_ctx(thread, stack, pc, prio, type, aff);
+	init_list_head(&thread->notification_queue_node);
+	wheel_timer_init(&thread->wait_timer, sched_wait_timeout);
+	sched_stat_register(thread);
 	/* add to process */
 	list_add(&thread->node, &process->thread_list);
 
@@ -60,6 +64,8 @@ void thread_deinit(void *thread_ptr)
 	bool exit_process = false;
 
 	thread = thread_ptr;
+	ipc_unpublish_thread(thread);
+	ipc_server_exit(thread);
 
 	switch (thread->thread_ctx->state)
 	{
@@ -72,9 +78,15 @@ void thread_deinit(void *thread_ptr)
 	case TS_READY:
 		sched_dequeue(thread);
 		/* fall through */
+	case TS_WAITING:
+		list_del(&thread->notification_queue_node);
+		init_list_head(&thread->notification_queue_node);
+		wheel_timer_cancel(&thread->wait_timer);
+		/* fall through */
 	default:
 		process = thread->process;
 		list_del(&thread->node);
+		sched_stat_unregister(thread);
 		if (list_empty(&process->thread_list))
 			exit_process = true;
 
@@ -349,8 +361,7 @@ void switch_thread_vmspace_to(struct thread *thread)
 /* Exit the current running thread */
 void sys_exit(int ret)
 {
-	int cpuid = smp_get_cpu_id();
-	struct thread *target = current_threads[cpuid];
+	struct thread *target = current_thread;
 
 	// kinfo("sys_exit with value %d\n", ret);
 	/* Set thread state */
@@ -358,7 +369,7 @@ void sys_exit(int ret)
 	obj_free(target);
 
 	/* Set current running thread to NULL */
-	current_threads[cpuid] = NULL;
+	current_thread = NULL;
 	/* Reschedule */
 	cur_sched_ops->sched();
 	eret_to_thread(switch_context());
@@ -389,12 +400,11 @@ int sys_create_thread(u64 process_cap, u64 stack, u64 pc, u64 arg, u32 prio,
 int sys_set_affinity(u64 thread_cap, s32 aff)
 {
 	struct thread *thread = NULL;
-	int cpu_id = smp_get_cpu_id();
 
 	/* currently, we use -1 to represent the current thread */
 	if (thread_cap == -1)
 	{
-		thread = current_threads[cpu_id];
+		thread = current_thread;
 		// BUG_ON(!thread);
 		if (thread == NULL)
 		{
@@ -441,13 +451,12 @@ int sys_set_affinity(u64 thread_cap, s32 aff)
 int sys_get_affinity(u64 thread_cap)
 {
 	struct thread *thread = NULL;
-	int cpuid = smp_get_cpu_id();
 	s32 aff = 0;
 
 	/* currently, we use -1 to represent the current thread */
 	if (thread_cap == -1)
 	{
-		thread = current_threads[cpuid];
+		thread = current_thread;
 		// BUG_ON(!thread);
 		if (thread == NULL)
 		{
@@ -15,13 +15,14 @@
 #include <common/list.h>
 #include <mm/vmspace.h>
 #include <sched/sched.h>
+#include <sched/timer_wheel.h>
+#include <sched/futex.h>
 #include <process/process.h>
 #include <common/smp.h>
 #include <ipc/ipc.h>
 
-extern struct thread *current_threads[PLAT_CPU_NUM];
-#define current_thread (current_threads[smp_get_cpu_id()])
-#define DEFAULT_KERNEL_STACK_SZ		(0x1000)
+#define current_thread (get_per_cpu_info()->cur_thread)
+#define DEFAULT_KERNEL_STACK_SZ		KSTACK_SIZE
 
 /* Arguments for the inital thread */
 #define ROOT_THREAD_STACK_BASE		(0x8000000)
@@ -31,13 +32,16 @@ extern struct thread *current_threads[PLAT_CPU_NUM];
 struct thread {
 	struct list_head node;	// link threads in a same process
 	struct list_head ready_queue_node;	// link threads in a ready queue
-	struct list_head notification_queue_node;	// link threads in a notification waiting queue
+	struct list_head notification_queue_node;	// link threads in a notification or futex waiting queue
+	struct wheel_timer wait_timer;	// wakes the thread up from a timed wait
+	struct futex_key futex_key;	// address waited on in a futex queue
+	struct list_head sched_stat_node;	// link all threads reported by sys_top
 	struct thread_ctx *thread_ctx;	// thread control block
 	struct vmspace *vmspace;	// memory mapping
 
 	struct process *process;
 
-	struct ipc_connection *active_conn;
+	struct ipc_handler *ipc_handler;	// set for handler threads of a server
 	struct server_ipc_config *server_ipc_config;
 };
 
@@ -17,27 +17,38 @@
 #include <common/registers.h>
 #include <process/thread.h>
 #include <sched/sched.h>
+#include <sched/fpu.h>
+#include <mm/kstack.h>
 
+/*
+ * The thread_ctx sits at the top of the kernel stack. Only it has to start
+ * zeroed, the rest of the stack is written before being read.
+ */
 struct thread_ctx *create_thread_ctx(void)
 {
 	void *kernel_stack;
+	struct thread_ctx *ctx;
 
-	kernel_stack = kzalloc(DEFAULT_KERNEL_STACK_SZ);
+	kernel_stack = kstack_alloc();
 	if (kernel_stack == NULL) {
 		kwarn("create_thread_ctx fails due to lack of memory\n");
 		return NULL;
 	}
-	return kernel_stack + DEFAULT_KERNEL_STACK_SZ -
+	ctx = kernel_stack + DEFAULT_KERNEL_STACK_SZ -
 	    sizeof(struct thread_ctx);
+	memset(ctx, 0, sizeof(struct thread_ctx));
+	return ctx;
 }
 
 void destroy_thread_ctx(struct thread *thread)
 {
 	void *kernel_stack;
 	BUG_ON(!thread->thread_ctx);
+	sched_stat_forget(thread);
+	fpu_forget(thread);
 	kernel_stack = (void *)thread->thread_ctx - DEFAULT_KERNEL_STACK_SZ +
 	    sizeof(struct thread_ctx);
-	kfree(kernel_stack);
+	kstack_free(kernel_stack);
 }
 
 void init_thread_ctx(struct thread *thread, u64 stack, u64 func, u32 prio,
@@ -76,7 +87,9 @@ void init_thread_ctx(struct thread *thread, u64 stack, u64 func, u32 prio,
 
 	/* Set the budget of the thread */
 	thread->thread_ctx->sc = kmalloc(sizeof(sched_cont_t));
-	thread->thread_ctx->sc->budget = DEFAULT_BUDGET;
+	thread->thread_ctx->sc->slice = DEFAULT_SLICE_US;
+	thread->thread_ctx->sc->budget = DEFAULT_SLICE_US;
+	thread->thread_ctx->sc->last_charge = 0;
 }
 
 u64 arch_get_thread_stack(struct thread *thread)
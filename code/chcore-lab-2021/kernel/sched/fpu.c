@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS),
+ * Shanghai Jiao Tong University (SJTU) OS-Lab-2020 (i.e., ChCore) is licensed
+ * under the Mulan PSL v1. You can use this software according to the terms and
+ * conditions of the Mulan PSL v1. You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY
+ * KIND, EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+ * NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE. See the
+ * Mulan PSL v1 for more details.
+ */
+
+/*
+ * Lazy FP/SIMD context switch. EL0 access to FP/SIMD traps (CPACR_EL1)
+ * until the running thread uses it for the first time after being
+ * switched in; only then is its state loaded. The state is written back
+ * when the CPU switches to another thread, and not reloaded if the
+ * thread comes back before anyone else used the registers.
+ */
+
+#include <common/errno.h>
+#include <common/kmalloc.h>
+#include <common/kprint.h>
+#include <common/lock.h>
+#include <common/macro.h>
+#include <common/smp.h>
+#include <process/thread.h>
+#include <sched/fpu.h>
+
+#define CPACR_EL1_FPEN_SHIFT	20
+#define CPACR_EL1_FPEN_MASK	(0b11UL << CPACR_EL1_FPEN_SHIFT)
+/* Trap FP/SIMD at EL0, the kernel itself does not use it */
+#define CPACR_EL1_FPEN_EL1	(0b01UL << CPACR_EL1_FPEN_SHIFT)
+#define CPACR_EL1_FPEN_ALL	(0b11UL << CPACR_EL1_FPEN_SHIFT)
+
+static inline void fpu_set_access(u64 fpen)
+{
+	u64 cpacr;
+
+	asm volatile ("mrs %0, cpacr_el1":"=r" (cpacr));
+	cpacr = (cpacr & ~CPACR_EL1_FPEN_MASK) | fpen;
+	asm volatile ("msr cpacr_el1, %0"::"r" (cpacr));
+	/* The eret back to the thread synchronizes the change */
+}
+
+void fpu_init(void)
+{
+	struct per_cpu_info *info = get_per_cpu_info();
+
+	info->fpu_owner = NULL;
+	info->fpu_enabled = false;
+	fpu_set_access(CPACR_EL1_FPEN_EL1);
+	asm volatile ("isb":::"memory");
+}
+
+/* Called by switch_context before returning to `target` */
+void fpu_switch_to(struct thread *target)
+{
+	struct per_cpu_info *info = get_per_cpu_info();
+	struct thread *owner = info->fpu_owner;
+
+	if (owner == target && target->thread_ctx->fpu_cpu == info->cpu_id) {
+		/* The registers still hold the state of target */
+		if (!info->fpu_enabled) {
+			info->fpu_enabled = true;
+			fpu_set_access(CPACR_EL1_FPEN_ALL);
+		}
+		return;
+	}
+
+	if (info->fpu_enabled) {
+		/* Only the owner can have used the registers */
+		fpu_save_state(owner->thread_ctx->fpu);
+		info->fpu_enabled = false;
+		fpu_set_access(CPACR_EL1_FPEN_EL1);
+	}
+}
+
+/* First FP/SIMD instruction of the current thread since it was switched in */
+void fpu_handle_trap(void)
+{
+	struct per_cpu_info *info = get_per_cpu_info();
+	struct thread *thread = current_thread;
+	struct thread_ctx *ctx;
+
+	BUG_ON(thread == NULL || info->fpu_enabled);
+	ctx = thread->thread_ctx;
+
+	if (ctx->fpu == NULL) {
+		/* The initial state is all zero */
+		ctx->fpu = kzalloc(sizeof(struct fpu_context));
+		if (ctx->fpu == NULL) {
+			kwarn("no memory for the FP/SIMD state\n");
+			sys_exit(-ENOMEM);
+		}
+	}
+
+	if (info->fpu_owner != thread || ctx->fpu_cpu != info->cpu_id)
+		fpu_restore_state(ctx->fpu);
+	info->fpu_owner = thread;
+	ctx->fpu_cpu = info->cpu_id;
+	info->fpu_enabled = true;
+	fpu_set_access(CPACR_EL1_FPEN_ALL);
+}
+
+/* Called before the thread_ctx of `thread` is freed */
+void fpu_forget(struct thread *thread)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < PLAT_CPU_NUM; cpu++) {
+		if (cpu_info[cpu].fpu_owner != thread)
+			continue;
+		/* A running thread is only freed by itself on its own CPU */
+		if (cpu_info[cpu].fpu_enabled) {
+			BUG_ON(cpu != smp_get_cpu_id());
+			fpu_set_access(CPACR_EL1_FPEN_EL1);
+		}
+		cpu_info[cpu].fpu_owner = NULL;
+		cpu_info[cpu].fpu_enabled = false;
+	}
+	if (thread->thread_ctx->fpu) {
+		kfree(thread->thread_ctx->fpu);
+		thread->thread_ctx->fpu = NULL;
+	}
+}
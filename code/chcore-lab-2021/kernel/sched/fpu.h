@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#pragma once
+
+#include <common/types.h>
+
+struct thread;
+
+/* Layout is used by fpu.S */
+struct fpu_context {
+	/* V0-V31 */
+	u64 vregs[64];
+	u32 fpsr;
+	u32 fpcr;
+};
+
+/* in sched/fpu.S */
+void fpu_save_state(struct fpu_context *fpu);
+void fpu_restore_state(struct fpu_context *fpu);
+
+void fpu_init(void);
+void fpu_switch_to(struct thread *target);
+void fpu_handle_trap(void);
+void fpu_forget(struct thread *thread);
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+/*
+ * Futex: block on a 32-bit word of user memory until another thread of
+ * the same address space wakes the address up.
+ */
+#include <sched/futex.h>
+#include <sched/sched.h>
+#include <sched/context.h>
+#include <sched/timer_wheel.h>
+#include <process/thread.h>
+#include <common/list.h>
+#include <common/macro.h>
+#include <common/errno.h>
+#include <common/mm.h>
+#include <common/uaccess.h>
+#include <exception/exception.h>
+
+struct list_head futex_queues[FUTEX_HASH_SIZE];
+
+void futex_init(void)
+{
+	int i;
+
+	for (i = 0; i < FUTEX_HASH_SIZE; i++)
+		init_list_head(&futex_queues[i]);
+}
+
+static inline struct list_head *futex_queue(struct futex_key *key)
+{
+	u64 hash = (u64) key->vmspace ^ (key->uaddr >> 2);
+
+	hash ^= hash >> FUTEX_HASH_BITS;
+	hash ^= hash >> (2 * FUTEX_HASH_BITS);
+	return &futex_queues[hash & (FUTEX_HASH_SIZE - 1)];
+}
+
+static int futex_get_key(u64 uaddr, struct futex_key *key)
+{
+	struct vmspace *vmspace = current_thread->vmspace;
+	struct vmregion *vmr;
+
+	if (!IS_ALIGNED(uaddr, sizeof(u32)) ||
+	    !is_user_addr_range(uaddr, sizeof(u32)))
+		return -EINVAL;
+	if (vmspace == NULL)
+		return -EINVAL;
+	read_lock(&vmspace->vmr_lock);
+	vmr = find_vmr_for_va(vmspace, uaddr);
+	read_unlock(&vmspace->vmr_lock);
+	if (vmr == NULL)
+		return -EINVAL;
+
+	key->vmspace = vmspace;
+	key->uaddr = uaddr;
+	return 0;
+}
+
+/*
+ * Block the current thread if *uaddr still equals `val`.
+ * Returns 0 when woken up, -EAGAIN if the value has changed and -ETIME
+ * if `timeout_us` (0 means no timeout) expires first.
+ */
+int sys_futex_wait(u64 uaddr, u32 val, u64 timeout_us)
+{
+	struct thread *thread = current_thread;
+	struct futex_key key;
+	u32 cur;
+	int ret;
+
+	ret = futex_get_key(uaddr, &key);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * The check and the enqueue are atomic with respect to
+	 * sys_futex_wake since both run under the kernel lock.
+	 */
+	copy_from_user((char *)&cur, (char *)uaddr, sizeof(cur));
+	if (cur != val)
+		return -EAGAIN;
+
+	sched_charge_budget(thread->thread_ctx->sc, 0);
+	thread->futex_key = key;
+	list_append(&thread->notification_queue_node, futex_queue(&key));
+	/* Overwritten by the waker, kept if the timer fires first */
+	arch_set_thread_return(thread, -ETIME);
+	thread->thread_ctx->state = TS_WAITING;
+	if (timeout_us != 0)
+		wheel_timer_add(&thread->wait_timer,
+				DIV_ROUND_UP(timeout_us, TICK_US));
+	current_thread = NULL;
+
+	sched();
+	eret_to_thread(switch_context());
+	/* Never returns */
+	return 0;
+}
+
+/* Wake up at most `nr_wake` waiters of uaddr, return the number woken */
+int sys_futex_wake(u64 uaddr, u32 nr_wake)
+{
+	struct futex_key key;
+	struct list_head *queue;
+	struct thread *waiter, *tmp;
+	int woken = 0;
+	int ret;
+
+	ret = futex_get_key(uaddr, &key);
+	if (ret < 0)
+		return ret;
+
+	queue = futex_queue(&key);
+	for_each_in_list_safe(waiter, tmp, notification_queue_node, queue) {
+		if (woken >= nr_wake)
+			break;
+		if (waiter->futex_key.vmspace != key.vmspace ||
+		    waiter->futex_key.uaddr != key.uaddr)
+			continue;
+
+		sched_wakeup(waiter, 0);
+		woken++;
+	}
+	return woken;
+}
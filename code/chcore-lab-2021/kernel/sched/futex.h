@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#pragma once
+
+#include <common/types.h>
+
+struct vmspace;
+
+/* Waiters are hashed by (vmspace, uaddr) into FUTEX_HASH_SIZE queues */
+#define FUTEX_HASH_BITS	6
+#define FUTEX_HASH_SIZE	(1 << FUTEX_HASH_BITS)
+
+struct futex_key {
+	struct vmspace *vmspace;
+	u64 uaddr;
+};
+
+void futex_init(void);
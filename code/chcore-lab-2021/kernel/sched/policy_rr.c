@@ -20,8 +20,11 @@
 #include <process/thread.h>
 #include <common/macro.h>
 #include <common/errno.h>
+#include <common/lock.h>
 #include <process/thread.h>
 #include <exception/irq.h>
+#include <exception/ipi.h>
+#include <exception/timer.h>
 #include <sched/context.h>
 
 /* in arch/sched/idle.S */
@@ -29,9 +32,9 @@ void idle_thread_routine(void);
 
 /*
  * rr_ready_queue
- * Per-CPU ready queue for ready tasks.
+ * Per-CPU ready queue for ready tasks, kept in per_cpu_info together with
+ * rr_ready_queue_lock which protects it.
  */
-struct list_head rr_ready_queue[PLAT_CPU_NUM];
 
 /*
  * RR policy also has idle threads.
@@ -42,14 +45,10 @@ struct list_head rr_ready_queue[PLAT_CPU_NUM];
 struct thread idle_threads[PLAT_CPU_NUM];
 
 /*
- * Lab4 - exercise 7
- * Sched_enqueue
- * Put `thread` at the end of ready queue of assigned `affinity`.
- * If affinity = NO_AFF, assign the core to the current cpu.
- * If the thread is IDEL thread, do nothing!
- * Do not forget to check if the affinity is valid!
+ * Put `thread` at the end of the ready queue of its affinity, or of
+ * `cpu_id` if it has none.
  */
-int rr_sched_enqueue(struct thread *thread)
+int rr_sched_enqueue_cpu(struct thread *thread, u32 cpu_id)
 {
 	if (thread == NULL || thread->thread_ctx == NULL || thread->thread_ctx->state == TS_READY)
 	{
@@ -62,38 +61,44 @@ int rr_sched_enqueue(struct thread *thread)
 	}
 
 	/* 
-	 * If affinity = NO_AFF, assign the core to the current cpu.
 	 * 将线程给他指定的cpu运行
 	 */
-	u32 cpu_id = smp_get_cpu_id();
 	if (thread->thread_ctx->affinity != NO_AFF)
-	{
 		cpu_id = thread->thread_ctx->affinity;
-		if (cpu_id >= PLAT_CPU_NUM)
-		{
-			return -EINVAL;
-		}
+	if (cpu_id >= PLAT_CPU_NUM)
+	{
+		return -EINVAL;
 	}
 
-	list_append(&thread->ready_queue_node, &rr_ready_queue[cpu_id]);
+	lock(&cpu_info[cpu_id].rr_ready_queue_lock);
+	list_append(&thread->ready_queue_node, &cpu_info[cpu_id].rr_ready_queue);
 	thread->thread_ctx->state = TS_READY;
+	sched_stat_enqueue(thread);
 	thread->thread_ctx->cpuid = cpu_id; /* [ERROR]: tst_sched_param:120 threads[i]->thread_ctx->cpuid != cpuid*/
+	unlock(&cpu_info[cpu_id].rr_ready_queue_lock);
+
+	/* Wake up the target instead of leaving the thread to its next tick */
+	if (cpu_id != smp_get_cpu_id())
+		ipi_send(cpu_id, IPI_RESCHED);
 	return 0;
 }
 
 /*
  * Lab4 - exercise 7
- * Sched_dequeue
- * remove `thread` from its current residual ready queue
- * Do not forget to add some basic parameter checking
+ * Sched_enqueue
+ * Put `thread` at the end of ready queue of assigned `affinity`.
+ * If affinity = NO_AFF, assign the core to the current cpu.
+ * If the thread is IDEL thread, do nothing!
+ * Do not forget to check if the affinity is valid!
  */
-int rr_sched_dequeue(struct thread *thread)
+int rr_sched_enqueue(struct thread *thread)
 {
-	if (thread == NULL || thread->thread_ctx == NULL || thread->thread_ctx->state != TS_READY)
-	{
-		return -EINVAL;
-	}
+	return rr_sched_enqueue_cpu(thread, smp_get_cpu_id());
+}
 
+/* Caller should hold the ready queue lock of thread->thread_ctx->cpuid */
+static int rr_sched_dequeue_nolock(struct thread *thread)
+{
 	/* 如果是空闲线程 则不用出队 */
 	if (thread->thread_ctx->type == TYPE_IDLE)
 	{
@@ -106,6 +111,29 @@ int rr_sched_dequeue(struct thread *thread)
 	return 0;
 }
 
+/*
+ * Lab4 - exercise 7
+ * Sched_dequeue
+ * remove `thread` from its current residual ready queue
+ * Do not forget to add some basic parameter checking
+ */
+int rr_sched_dequeue(struct thread *thread)
+{
+	u32 cpu_id;
+	int ret;
+
+	if (thread == NULL || thread->thread_ctx == NULL || thread->thread_ctx->state != TS_READY)
+	{
+		return -EINVAL;
+	}
+
+	cpu_id = thread->thread_ctx->cpuid;
+	lock(&cpu_info[cpu_id].rr_ready_queue_lock);
+	ret = rr_sched_dequeue_nolock(thread);
+	unlock(&cpu_info[cpu_id].rr_ready_queue_lock);
+	return ret;
+}
+
 /*
  * Lab4 - exercise 7
  * The helper function
@@ -122,37 +150,39 @@ struct thread *rr_sched_choose_thread(void)
 	/* 首先检查CPU 核心的rr_ready_queue是否为空
 	 * 如果是，rr_choose_thread返回CPU 核心自己的空闲线程 
 	 */
-	u32 cpu_id = smp_get_cpu_id();
-	if (list_empty(&(rr_ready_queue[cpu_id])))
+	struct per_cpu_info *info = get_per_cpu_info();
+	lock(&info->rr_ready_queue_lock);
+	if (list_empty(&info->rr_ready_queue))
 	{
-		return &(idle_threads[cpu_id]);
+		unlock(&info->rr_ready_queue_lock);
+		return info->idle_thread;
 	}
 
 	/*
 	 * 如果没有，它将选择rr_ready_queue的队首
 	 * 并调用rr_sched_dequeue()使该队首出队，然后返回该队首
 	 */
-	struct thread *chosen_thread = list_entry(rr_ready_queue[cpu_id].next, struct thread, ready_queue_node);
-	if (rr_sched_dequeue(chosen_thread) < 0)
-	{
-		return NULL;
-	}
+	struct thread *chosen_thread = list_entry(info->rr_ready_queue.next, struct thread, ready_queue_node);
+	BUG_ON(chosen_thread->thread_ctx->state != TS_READY);
+	rr_sched_dequeue_nolock(chosen_thread);
+	unlock(&info->rr_ready_queue_lock);
 	return chosen_thread;
 }
 
-static inline void rr_sched_refill_budget(struct thread *target, u32 budget)
+static inline void rr_sched_refill_budget(struct thread *target)
 {
-	target->thread_ctx->sc->budget = budget;
+	sched_refill_budget(target->thread_ctx->sc);
 }
 
 /*
  * Lab4 - exercise 7
  * Schedule a thread to execute.
  * This function will suspend current running thread, if any, and schedule
- * another thread from `rr_ready_queue[cpu_id]`.
+ * another thread from the ready queue of the current CPU.
  * 
  * Hints:
- * Macro DEFAULT_BUDGET defines the value for resetting thread's budget.
+ * A thread's budget is refilled to its own slice (DEFAULT_SLICE_US unless
+ * set with sys_set_time_slice) once it is used up.
  * After you get one thread from rr_sched_choose_thread, pass it to
  * switch_to_thread() to prepare for switch_context().
  * Then ChCore can call eret_to_thread() to return to user mode.
@@ -162,7 +192,8 @@ int rr_sched(void)
 	/*  
 	 * 调度器应只能在某个线程预算等于零时才能调度该线程
 	 */
-	if (current_thread != NULL && current_thread->thread_ctx != NULL && current_thread->thread_ctx->sc != NULL && current_thread->thread_ctx->sc->budget != 0)
+	if (current_thread != NULL && current_thread->thread_ctx != NULL && current_thread->thread_ctx->sc != NULL && current_thread->thread_ctx->sc->budget != 0
+	    && current_thread->thread_ctx->type != TYPE_IDLE)
 	{
 		return 0;
 	}
@@ -173,6 +204,9 @@ int rr_sched(void)
 	 */
 	if (current_thread != NULL)
 	{
+		/* Still running with the budget used up: preempted */
+		if (current_thread->thread_ctx->type != TYPE_IDLE)
+			sched_stat_preempt(current_thread);
 		rr_sched_enqueue(current_thread);
 	}
 
@@ -182,8 +216,8 @@ int rr_sched(void)
 		return -EINVAL;
 	}
 
-	/* resetting thread's budget */
-	rr_sched_refill_budget(target_thread, DEFAULT_BUDGET);
+	/* refill the budget if used up and restart the accounting */
+	rr_sched_refill_budget(target_thread);
 
 	return switch_to_thread(target_thread);
 }
@@ -198,8 +232,10 @@ int rr_sched_init(void)
 	/* Initialize global variables */
 	for (i = 0; i < PLAT_CPU_NUM; i++)
 	{
-		current_threads[i] = NULL;
-		init_list_head(&rr_ready_queue[i]);
+		cpu_info[i].cur_thread = NULL;
+		cpu_info[i].idle_thread = &idle_threads[i];
+		init_list_head(&cpu_info[i].rr_ready_queue);
+		lock_init(&cpu_info[i].rr_ready_queue_lock);
 	}
 
 	/* Initialize one idle thread for each core and insert into the RQ */
@@ -215,6 +251,7 @@ int rr_sched_init(void)
 						   idle_thread_routine);
 		/* Idle thread is kernel thread which do not have vmspace */
 		idle_threads[i].vmspace = NULL;
+		sched_stat_register(&idle_threads[i]);
 	}
 	kdebug("Scheduler initialized. Create %d idle threads.\n", i);
 
@@ -228,9 +265,37 @@ int rr_sched_init(void)
  */
 void rr_sched_handle_timer_irq(void)
 {
-	if (current_thread != NULL && current_thread->thread_ctx->sc->budget > 0)
+	if (current_thread != NULL && current_thread->thread_ctx->sc != NULL)
 	{
-		current_thread->thread_ctx->sc->budget--;
+		sched_charge_budget(current_thread->thread_ctx->sc, TICK_US);
+	}
+}
+
+/*
+ * Print the running thread and the ready queue of every CPU together with
+ * the latest switch events.
+ */
+void rr_sched_top(void)
+{
+	struct thread *thread;
+	int cpu;
+
+	for (cpu = 0; cpu < PLAT_CPU_NUM; cpu++) {
+		printk("===== CPU %d =====\n", cpu);
+		if (cpu_info[cpu].cur_thread) {
+			printk("running: ");
+			sched_stat_print(cpu_info[cpu].cur_thread);
+		}
+		lock(&cpu_info[cpu].rr_ready_queue_lock);
+		for_each_in_list(thread, struct thread, ready_queue_node,
+				 &cpu_info[cpu].rr_ready_queue) {
+			printk("ready:   ");
+			sched_stat_print(thread);
+		}
+		unlock(&cpu_info[cpu].rr_ready_queue_lock);
+		printk("idle:    ");
+		sched_stat_print(&idle_threads[cpu]);
+		sched_trace_print(cpu, 8);
 	}
 }
 
@@ -238,7 +303,9 @@ struct sched_ops rr = {
 	.sched_init = rr_sched_init,
 	.sched = rr_sched,
 	.sched_enqueue = rr_sched_enqueue,
+	.sched_enqueue_cpu = rr_sched_enqueue_cpu,
 	.sched_dequeue = rr_sched_dequeue,
 	.sched_choose_thread = rr_sched_choose_thread,
 	.sched_handle_timer_irq = rr_sched_handle_timer_irq,
+	.sched_top = rr_sched_top,
 };
@@ -23,9 +23,11 @@
 #include <common/errno.h>
 #include <process/thread.h>
 #include <exception/exception.h>
+#include <exception/timer.h>
 #include <sched/context.h>
-
-struct thread *current_threads[PLAT_CPU_NUM];
+#include <sched/fpu.h>
+#include <sched/timer_wheel.h>
+#include <sched/futex.h>
 
 /* Chosen Scheduling Policies */
 struct sched_ops *cur_sched_ops;
@@ -67,7 +69,7 @@ void arch_idle_ctx_init(struct thread_ctx *idle_ctx, void (*func) (void))
 void print_thread(struct thread *thread)
 {
 	printk
-	    ("Thread %p\tType: %s\tState: %s\tCPU %d\tAFF %d\tBudget %d\tPrio: %d\t\n",
+	    ("Thread %p\tType: %s\tState: %s\tCPU %d\tAFF %d\tBudget %lu\tPrio: %d\t\n",
 	     thread, thread_type[thread->thread_ctx->type],
 	     thread_state[thread->thread_ctx->state], thread->thread_ctx->cpuid,
 	     thread->thread_ctx->affinity, thread->thread_ctx->sc->budget,
@@ -84,6 +86,45 @@ int sched_is_running(struct thread *target)
 	return 0;
 }
 
+/*
+ * Charge the time consumed since the last charge to the budget of `sc`.
+ * At least `min_us` is charged: a tick always costs a whole tick, while
+ * yield and IPC charge exactly what has been used.
+ */
+void sched_charge_budget(sched_cont_t *sc, u64 min_us)
+{
+	u64 now, used;
+
+	if (sc == NULL)
+		return;
+
+	now = plat_get_cycles();
+	used = plat_cycles_to_us(now - sc->last_charge);
+	if (used < min_us)
+		used = min_us;
+	sc->last_charge = now;
+
+	if (used >= sc->budget)
+		sc->budget = 0;
+	else
+		sc->budget -= used;
+}
+
+/*
+ * Give `sc` a new slice if the last one is used up and restart the
+ * accounting from now. A thread preempted or yielding with some budget
+ * left resumes with the remainder instead of a fresh slice.
+ */
+void sched_refill_budget(sched_cont_t *sc)
+{
+	if (sc == NULL)
+		return;
+
+	if (sc->budget == 0)
+		sc->budget = sc->slice;
+	sc->last_charge = plat_get_cycles();
+}
+
 /*
  * Switch Thread to the specified one.
  * Set the correct thread state to running and the current_thread
@@ -94,6 +135,7 @@ int switch_to_thread(struct thread *target)
 	BUG_ON(!target->thread_ctx);
 	BUG_ON((target->thread_ctx->state == TS_READY));
 
+	sched_stat_switch(target);
 	target->thread_ctx->cpuid = smp_get_cpu_id();
 	target->thread_ctx->state = TS_RUNNING;
 	smp_wmb();
@@ -124,6 +166,7 @@ u64 switch_context(void)
 		BUG_ON(!target_thread->vmspace);
 		switch_thread_vmspace_to(target_thread);
 	}
+	fpu_switch_to(target_thread);
 	/*
 	 * Lab3: Your code here
 	 * Return the correct value in order to make eret_to_thread work correctly
@@ -148,17 +191,114 @@ u64 switch_context(void)
  */
 void sys_yield(void)
 {
-	if(current_thread!=NULL && current_thread->thread_ctx!=NULL)
-		current_thread->thread_ctx->sc->budget=0;
+	struct thread *thread = current_thread;
+
+	/*
+	 * Charge what has been used so far and go to the tail of the ready
+	 * queue with the remaining budget, so yielding right before the tick
+	 * does not hand out a fresh slice.
+	 */
+	if (thread != NULL && thread->thread_ctx != NULL) {
+		sched_charge_budget(thread->thread_ctx->sc, 0);
+		sched_enqueue(thread);
+		current_thread = NULL;
+	}
 	sched();
 	eret_to_thread(switch_context()); 
 }
 
+/*
+ * Expiry handler of thread->wait_timer: put the thread back to the ready
+ * queue if it is still waiting. The return value of the wait has been
+ * set by the waiter before blocking.
+ */
+void sched_wait_timeout(struct wheel_timer *timer)
+{
+	struct thread *thread = container_of(timer, struct thread, wait_timer);
+
+	if (thread->thread_ctx->state != TS_WAITING)
+		return;
+	/* Leave the futex or notification queue it may wait on */
+	list_del(&thread->notification_queue_node);
+	init_list_head(&thread->notification_queue_node);
+	BUG_ON(sched_enqueue(thread));
+}
+
+/*
+ * Wake up a thread blocked in a (timed) wait and make the wait return
+ * `ret`. Called with the kernel lock held.
+ */
+void sched_wakeup(struct thread *thread, u64 ret)
+{
+	BUG_ON(thread->thread_ctx->state != TS_WAITING);
+
+	list_del(&thread->notification_queue_node);
+	init_list_head(&thread->notification_queue_node);
+	wheel_timer_cancel(&thread->wait_timer);
+	arch_set_thread_return(thread, ret);
+	BUG_ON(sched_enqueue(thread));
+}
+
+/*
+ * Block the current thread for at least `us` microseconds.
+ * The sleep is rounded up to whole ticks of the current CPU.
+ */
+void sys_sleep(u64 us)
+{
+	struct thread *thread = current_thread;
+
+	if (us == 0)
+		sys_yield();
+
+	sched_charge_budget(thread->thread_ctx->sc, 0);
+	/* We do not come back through the syscall path */
+	arch_set_thread_return(thread, 0);
+	thread->thread_ctx->state = TS_WAITING;
+	wheel_timer_add(&thread->wait_timer, DIV_ROUND_UP(us, TICK_US));
+	current_thread = NULL;
+
+	sched();
+	eret_to_thread(switch_context());
+}
+
+/*
+ * Set the length of the time slice of a thread in microseconds.
+ * The new length takes effect from the next refill.
+ */
+int sys_set_time_slice(u64 thread_cap, u64 slice_us)
+{
+	struct thread *thread = NULL;
+
+	if (slice_us < MIN_SLICE_US || slice_us > MAX_SLICE_US)
+		return -EINVAL;
+
+	/* currently, we use -1 to represent the current thread */
+	if (thread_cap == -1) {
+		thread = current_thread;
+		if (thread == NULL)
+			return -ECAPBILITY;
+	} else {
+		thread = obj_get(current_process, thread_cap, TYPE_THREAD);
+		if (thread == NULL)
+			return -ECAPBILITY;
+	}
+
+	thread->thread_ctx->sc->slice = slice_us;
+	if (thread->thread_ctx->sc->budget > slice_us)
+		thread->thread_ctx->sc->budget = slice_us;
+
+	if (thread_cap != -1)
+		obj_put(thread);
+	return 0;
+}
+
 int sched_init(struct sched_ops *sched_ops)
 {
 	BUG_ON(sched_ops == NULL);
 
 	cur_sched_ops = sched_ops;
+	timer_wheel_init();
+	futex_init();
 	cur_sched_ops->sched_init();
 	return 0;
 }
@@ -18,12 +18,20 @@
 #include <common/kprint.h>
 
 #include <common/machine.h>
+#include <sched/stat.h>
 
 struct thread;
+struct fpu_context;
+struct wheel_timer;
 
-/* BUDGET represents the number of TICKs */
+/* Period of the scheduler tick */
+#define TICK_US		10000
+/* BUDGET represents the number of TICKs in a default time slice */
 #define DEFAULT_BUDGET	2
-#define TICK_MS		500
+#define DEFAULT_SLICE_US	(DEFAULT_BUDGET * TICK_US)
+/* Bounds of the slice a thread can ask for */
+#define MIN_SLICE_US	100
+#define MAX_SLICE_US	(1000 * 1000)
 
 #define MAX_PRIO	255
 #define MIN_PRIO	0
@@ -58,9 +66,18 @@ enum thread_type {
 	TYPE_TESTS
 };
 
+/*
+ * Budgets are kept in microseconds and charged with the time actually
+ * consumed (measured with cntpct_el0) instead of whole ticks.
+ */
 typedef struct sched_cont {
-	u32 budget;
-	char pad[pad_to_cache_line(sizeof(u32))];
+	/* Remaining budget of the current slice (us) */
+	u64 budget;
+	/* Length of a full slice, used to refill the budget (us) */
+	u64 slice;
+	/* Counter value when the budget was last charged */
+	u64 last_charge;
+	char pad[pad_to_cache_line(3 * sizeof(u64))];
 } sched_cont_t;
 
 /* size in registers.h (to be used in asm) */
@@ -89,6 +106,14 @@ struct thread_ctx {
 
 	/* Current Assigned CPU */
 	u32 cpuid;
+
+	/* Statistics reported by sys_top */
+	struct sched_stat stat;
+
+	/* FP/SIMD state, allocated on the first use (see fpu.c) */
+	struct fpu_context *fpu;
+	/* CPU which last loaded the state into its registers */
+	u32 fpu_cpu;
 };
 
 /* Debug functions */
@@ -102,16 +127,21 @@ u64 switch_context(void);
 int sched_is_runnable(struct thread *target);
 int sched_is_running(struct thread *target);
 int switch_to_thread(struct thread *target);
+void sched_charge_budget(sched_cont_t *sc, u64 min_us);
+void sched_refill_budget(sched_cont_t *sc);
+void sched_wait_timeout(struct wheel_timer *timer);
+void sched_wakeup(struct thread *thread, u64 ret);
 
 /* Global-shared kernel data */
 extern struct list_head ready_queue[PLAT_CPU_NUM][PRIO_NUM];
-extern struct thread *current_threads[PLAT_CPU_NUM];
 
 /* Indirect function call may downgrade performance */
 struct sched_ops {
 	int (*sched_init) (void);
 	int (*sched) (void);
 	int (*sched_enqueue) (struct thread * thread);
+	/* Like sched_enqueue, a thread without affinity goes to `cpuid` */
+	int (*sched_enqueue_cpu) (struct thread * thread, u32 cpuid);
 	int (*sched_dequeue) (struct thread * thread);
 	struct thread *(*sched_choose_thread) (void);
 	void (*sched_handle_timer_irq) (void);
@@ -137,6 +167,11 @@ static inline int sched_enqueue(struct thread *thread)
 	return cur_sched_ops->sched_enqueue(thread);
 }
 
+static inline int sched_enqueue_cpu(struct thread *thread, u32 cpuid)
+{
+	return cur_sched_ops->sched_enqueue_cpu(thread, cpuid);
+}
+
 static inline int sched_dequeue(struct thread *thread)
 {
 	return cur_sched_ops->sched_dequeue(thread);
@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#include <sched/stat.h>
+#include <sched/sched.h>
+#include <common/smp.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <common/errno.h>
+#include <common/mm.h>
+#include <common/uaccess.h>
+#include <exception/timer.h>
+#include <process/thread.h>
+
+/* All threads known to sys_top, linked by sched_stat_node */
+static struct list_head stat_threads = {
+	.prev = &stat_threads,
+	.next = &stat_threads,
+};
+
+struct sched_trace {
+	u64 head;
+	struct sched_trace_event events[SCHED_TRACE_SIZE];
+};
+
+static struct sched_trace sched_traces[PLAT_CPU_NUM];
+
+void sched_stat_register(struct thread *thread)
+{
+	list_append(&thread->sched_stat_node, &stat_threads);
+}
+
+void sched_stat_unregister(struct thread *thread)
+{
+	list_del(&thread->sched_stat_node);
+}
+
+/* Called before the thread_ctx of `thread` is freed */
+void sched_stat_forget(struct thread *thread)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < PLAT_CPU_NUM; cpu++) {
+		if (cpu_info[cpu].last_thread == thread) {
+			cpu_info[cpu].last_thread = NULL;
+			cpu_info[cpu].last_exited = true;
+		}
+	}
+}
+
+void sched_stat_enqueue(struct thread *thread)
+{
+	thread->thread_ctx->stat.last_enqueue = plat_get_cycles();
+}
+
+/* The policy switches `thread` out with its budget used up */
+void sched_stat_preempt(struct thread *thread)
+{
+	thread->thread_ctx->stat.preempted = true;
+}
+
+static void sched_trace_record(u32 cpuid, u64 now, struct thread *prev,
+			       struct thread *next, u32 reason)
+{
+	struct sched_trace *trace = &sched_traces[cpuid];
+	struct sched_trace_event *event;
+
+	event = &trace->events[trace->head % SCHED_TRACE_SIZE];
+	event->timestamp = plat_cycles_to_us(now);
+	event->prev = (u64) prev;
+	event->next = (u64) next;
+	event->cpuid = cpuid;
+	event->reason = reason;
+	trace->head++;
+}
+
+/*
+ * Account the switch from the last thread of this CPU to `target`.
+ * per_cpu_info.last_thread is the thread last switched in on each CPU. It
+ * is the one switched out by the next switch_to_thread on that CPU.
+ * last_exited is set if it has been freed before the next switch.
+ */
+void sched_stat_switch(struct thread *target)
+{
+	struct per_cpu_info *info = get_per_cpu_info();
+	u32 cpuid = info->cpu_id;
+	struct thread *prev = info->last_thread;
+	struct sched_stat *stat;
+	u64 now = plat_get_cycles();
+	u32 reason;
+
+	if (prev == target) {
+		target->thread_ctx->stat.preempted = false;
+		return;
+	}
+
+	if (prev) {
+		stat = &prev->thread_ctx->stat;
+		stat->runtime += now - stat->last_switch_in;
+		if (stat->preempted) {
+			stat->nr_involuntary++;
+			reason = SWITCH_INVOLUNTARY;
+		} else {
+			stat->nr_voluntary++;
+			reason = SWITCH_VOLUNTARY;
+		}
+		stat->preempted = false;
+	} else {
+		reason = info->last_exited ? SWITCH_EXIT : SWITCH_VOLUNTARY;
+	}
+	info->last_exited = false;
+
+	stat = &target->thread_ctx->stat;
+	if (stat->last_enqueue) {
+		stat->wait_time += now - stat->last_enqueue;
+		stat->last_enqueue = 0;
+	}
+	if (stat->nr_switches && stat->last_cpu != cpuid)
+		stat->nr_migrations++;
+	stat->nr_switches++;
+	stat->last_cpu = cpuid;
+	stat->last_switch_in = now;
+	stat->preempted = false;
+
+	info->last_thread = target;
+	sched_trace_record(cpuid, now, prev, target, reason);
+}
+
+/* Runtime including the current run if `thread` is on a CPU right now */
+static u64 sched_stat_runtime(struct thread *thread)
+{
+	struct sched_stat *stat = &thread->thread_ctx->stat;
+	u64 runtime = stat->runtime;
+
+	if (stat->nr_switches && cpu_info[stat->last_cpu].last_thread == thread)
+		runtime += plat_get_cycles() - stat->last_switch_in;
+	return plat_cycles_to_us(runtime);
+}
+
+static void fill_top_thread_info(struct thread *thread,
+				 struct top_thread_info *info)
+{
+	struct thread_ctx *ctx = thread->thread_ctx;
+
+	info->thread = (u64) thread;
+	info->type = ctx->type;
+	info->state = ctx->state;
+	info->prio = ctx->prio;
+	info->cpuid = ctx->cpuid;
+	info->runtime_us = sched_stat_runtime(thread);
+	info->nr_switches = ctx->stat.nr_switches;
+	info->nr_voluntary = ctx->stat.nr_voluntary;
+	info->nr_involuntary = ctx->stat.nr_involuntary;
+	info->wait_time_us = plat_cycles_to_us(ctx->stat.wait_time);
+	info->nr_migrations = ctx->stat.nr_migrations;
+}
+
+void sched_stat_print(struct thread *thread)
+{
+	struct top_thread_info info;
+
+	fill_top_thread_info(thread, &info);
+	printk("%p %s %s CPU %u run %lu us sw %lu vol %lu invol %lu "
+	       "wait %lu us mig %lu\n", thread, thread_type[info.type],
+	       thread_state[info.state], info.cpuid, info.runtime_us,
+	       info.nr_switches, info.nr_voluntary, info.nr_involuntary,
+	       info.wait_time_us, info.nr_migrations);
+}
+
+/* Print the last `nr` switch events of `cpuid` */
+void sched_trace_print(u32 cpuid, u32 nr)
+{
+	struct sched_trace *trace = &sched_traces[cpuid];
+	struct sched_trace_event *event;
+	u64 i;
+
+	if (nr > SCHED_TRACE_SIZE)
+		nr = SCHED_TRACE_SIZE;
+	if (nr > trace->head)
+		nr = trace->head;
+
+	for (i = trace->head - nr; i < trace->head; i++) {
+		event = &trace->events[i % SCHED_TRACE_SIZE];
+		printk("[%lu us] CPU %u %lx -> %lx (%u)\n", event->timestamp,
+		       event->cpuid, event->prev, event->next, event->reason);
+	}
+}
+
+static int top_copy_threads(u64 buf, u64 nr)
+{
+	struct thread *thread;
+	struct top_thread_info info;
+	u64 copied = 0;
+
+	for_each_in_list(thread, struct thread, sched_stat_node,
+			 &stat_threads) {
+		if (copied == nr)
+			break;
+		fill_top_thread_info(thread, &info);
+		if (copy_to_user((char *)(buf + copied * sizeof(info)),
+				 (char *)&info, sizeof(info)) < 0)
+			return -EFAULT;
+		copied++;
+	}
+	return copied;
+}
+
+/* Copy the switch events still in the rings, oldest first per CPU */
+static int top_copy_trace(u64 buf, u64 nr)
+{
+	struct sched_trace *trace;
+	struct sched_trace_event *event;
+	u64 copied = 0;
+	u64 i, start;
+	int cpu;
+
+	for (cpu = 0; cpu < PLAT_CPU_NUM; cpu++) {
+		trace = &sched_traces[cpu];
+		start = trace->head > SCHED_TRACE_SIZE ?
+		    trace->head - SCHED_TRACE_SIZE : 0;
+		for (i = start; i < trace->head && copied < nr; i++) {
+			event = &trace->events[i % SCHED_TRACE_SIZE];
+			if (copy_to_user((char *)(buf + copied * sizeof(*event)),
+					 (char *)event, sizeof(*event)) < 0)
+				return -EFAULT;
+			copied++;
+		}
+	}
+	return copied;
+}
+
+/*
+ * TOP_PRINT: print the scheduler state on the console (usys_top()).
+ * TOP_THREADS/TOP_TRACE: copy at most `nr` top_thread_info or
+ * sched_trace_event records to `buf` and return the number copied.
+ */
+int sys_top(u64 cmd, u64 buf, u64 nr)
+{
+	u64 size;
+
+	switch (cmd) {
+	case TOP_PRINT:
+		if (cur_sched_ops->sched_top)
+			cur_sched_ops->sched_top();
+		return 0;
+	case TOP_THREADS:
+		size = nr * sizeof(struct top_thread_info);
+		break;
+	case TOP_TRACE:
+		size = nr * sizeof(struct sched_trace_event);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (nr == 0)
+		return 0;
+	if (nr > (1UL << 20) || !is_user_addr_range(buf, size))
+		return -EINVAL;
+
+	if (cmd == TOP_THREADS)
+		return top_copy_threads(buf, nr);
+	return top_copy_trace(buf, nr);
+}
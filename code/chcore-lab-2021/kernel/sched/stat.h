@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+/* Per-thread scheduling statistics and the per-CPU switch trace */
+#pragma once
+
+#include <common/types.h>
+#include <common/list.h>
+
+struct thread;
+
+/* Kept in thread_ctx, which is zeroed on creation */
+struct sched_stat {
+	/* Time spent running (cycles) */
+	u64 runtime;
+	/* Number of times switched in */
+	u64 nr_switches;
+	/* Gave up the CPU by yielding, blocking or calling/returning IPC */
+	u64 nr_voluntary;
+	/* Switched out because the budget was used up */
+	u64 nr_involuntary;
+	/* Time spent in a ready queue (cycles) */
+	u64 wait_time;
+	/* Switched in on another CPU than the last time */
+	u64 nr_migrations;
+
+	u64 last_switch_in;
+	u64 last_enqueue;
+	u32 last_cpu;
+	bool preempted;
+};
+
+/* Number of switch events kept per CPU */
+#define SCHED_TRACE_SIZE	256
+
+enum sched_switch_reason {
+	SWITCH_VOLUNTARY = 0,
+	SWITCH_INVOLUNTARY,
+	/* The previous thread has exited or been freed */
+	SWITCH_EXIT,
+};
+
+struct sched_trace_event {
+	/* us since boot */
+	u64 timestamp;
+	/* kernel address of the threads, 0 for none */
+	u64 prev;
+	u64 next;
+	u32 cpuid;
+	u32 reason;
+};
+
+/* Commands of sys_top */
+#define TOP_PRINT	0
+#define TOP_THREADS	1
+#define TOP_TRACE	2
+
+/* Record copied to user space by TOP_THREADS */
+struct top_thread_info {
+	u64 thread;
+	u32 type;
+	u32 state;
+	u32 prio;
+	u32 cpuid;
+	u64 runtime_us;
+	u64 nr_switches;
+	u64 nr_voluntary;
+	u64 nr_involuntary;
+	u64 wait_time_us;
+	u64 nr_migrations;
+};
+
+void sched_stat_register(struct thread *thread);
+void sched_stat_unregister(struct thread *thread);
+void sched_stat_forget(struct thread *thread);
+void sched_stat_enqueue(struct thread *thread);
+void sched_stat_preempt(struct thread *thread);
+void sched_stat_switch(struct thread *target);
+void sched_stat_print(struct thread *thread);
+void sched_trace_print(u32 cpuid, u32 nr);
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#include <sched/timer_wheel.h>
+#include <common/smp.h>
+#include <common/machine.h>
+#include <common/macro.h>
+#include <common/kprint.h>
+#include <common/errno.h>
+
+struct timer_wheel timer_wheels[PLAT_CPU_NUM];
+
+void timer_wheel_init(void)
+{
+	int cpu, level, slot;
+
+	for (cpu = 0; cpu < PLAT_CPU_NUM; cpu++) {
+		timer_wheels[cpu].now = 0;
+		for (level = 0; level < TW_LEVELS; level++)
+			for (slot = 0; slot < TW_LEVEL_SIZE; slot++)
+				init_list_head(&timer_wheels[cpu].
+					       slots[level][slot]);
+	}
+}
+
+void wheel_timer_init(struct wheel_timer *timer, wheel_timer_func_t func)
+{
+	init_list_head(&timer->node);
+	timer->expire = 0;
+	timer->cpuid = -1;
+	timer->func = func;
+}
+
+/*
+ * Put `timer` into the slot matching its expiry. A timer expiring now
+ * goes to the current level 0 slot, which is only valid while cascading
+ * right before that slot is run.
+ */
+static void __wheel_timer_queue(struct timer_wheel *wheel,
+				struct wheel_timer *timer)
+{
+	u64 expire = timer->expire;
+	u64 delta = expire - wheel->now;
+	int level;
+
+	/* Too far away: park it in the last slot and requeue on cascade */
+	if (delta > TW_MAX_TICKS)
+		expire = wheel->now + TW_MAX_TICKS;
+
+	for (level = 0; level < TW_LEVELS - 1; level++)
+		if (delta < (1UL << (TW_LEVEL_BITS * (level + 1))))
+			break;
+
+	list_append(&timer->node, &wheel->slots[level]
+		    [(expire >> (TW_LEVEL_BITS * level)) & TW_LEVEL_MASK]);
+}
+
+/* Arm `timer` on the wheel of the current CPU to fire in `ticks` ticks */
+void wheel_timer_add(struct wheel_timer *timer, u64 ticks)
+{
+	u32 cpuid = smp_get_cpu_id();
+	struct timer_wheel *wheel = &timer_wheels[cpuid];
+
+	BUG_ON(wheel_timer_pending(timer));
+
+	if (ticks == 0)
+		ticks = 1;
+	timer->expire = wheel->now + ticks;
+	timer->cpuid = cpuid;
+	__wheel_timer_queue(wheel, timer);
+}
+
+/* Return 0 if `timer` was pending and has been removed */
+int wheel_timer_cancel(struct wheel_timer *timer)
+{
+	if (!wheel_timer_pending(timer))
+		return -ENOENT;
+
+	list_del(&timer->node);
+	init_list_head(&timer->node);
+	timer->cpuid = -1;
+	return 0;
+}
+
+/* Move every timer of an upper level slot down to the lower levels */
+static void cascade(struct timer_wheel *wheel, int level)
+{
+	struct list_head *slot;
+	struct list_head pending;
+	struct wheel_timer *timer;
+	int idx;
+
+	idx = (wheel->now >> (TW_LEVEL_BITS * level)) & TW_LEVEL_MASK;
+	slot = &wheel->slots[level][idx];
+	if (list_empty(slot))
+		return;
+
+	/* Detach the whole slot first since requeueing may refill it */
+	pending = *slot;
+	pending.next->prev = &pending;
+	pending.prev->next = &pending;
+	init_list_head(slot);
+
+	while (!list_empty(&pending)) {
+		timer = list_entry(pending.next, struct wheel_timer, node);
+		list_del(&timer->node);
+		__wheel_timer_queue(wheel, timer);
+	}
+}
+
+/*
+ * Called on every scheduler tick of the current CPU.
+ * Advances the wheel and runs the timers which expire on this tick.
+ */
+void timer_wheel_tick(void)
+{
+	struct timer_wheel *wheel = &timer_wheels[smp_get_cpu_id()];
+	struct list_head *slot;
+	struct wheel_timer *timer;
+	int level;
+
+	wheel->now++;
+
+	for (level = 1; level < TW_LEVELS; level++) {
+		if ((wheel->now & ((1UL << (TW_LEVEL_BITS * level)) - 1)) != 0)
+			break;
+		cascade(wheel, level);
+	}
+
+	slot = &wheel->slots[0][wheel->now & TW_LEVEL_MASK];
+	while (!list_empty(slot)) {
+		timer = list_entry(slot->next, struct wheel_timer, node);
+		list_del(&timer->node);
+		init_list_head(&timer->node);
+		timer->cpuid = -1;
+		if (timer->func)
+			timer->func(timer);
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020 Institute of Parallel And Distributed Systems (IPADS), Shanghai Jiao Tong University (SJTU)
+ * OS-Lab-2020 (i.e., ChCore) is licensed under the Mulan PSL v1.
+ * You can use this software according to the terms and conditions of the Mulan PSL v1.
+ * You may obtain a copy of Mulan PSL v1 at:
+ *   http://license.coscl.org.cn/MulanPSL
+ *   THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND, EITHER EXPRESS OR
+ *   IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT, MERCHANTABILITY OR FIT FOR A PARTICULAR
+ *   PURPOSE.
+ *   See the Mulan PSL v1 for more details.
+ */
+
+#pragma once
+
+#include <common/types.h>
+#include <common/list.h>
+
+/*
+ * Per-CPU hierarchical timer wheel driven by the scheduler tick.
+ * Level 0 has one slot per tick, each upper level covers a whole
+ * lower wheel per slot and is cascaded down when the lower one wraps.
+ */
+#define TW_LEVEL_BITS	6
+#define TW_LEVEL_SIZE	(1 << TW_LEVEL_BITS)
+#define TW_LEVEL_MASK	(TW_LEVEL_SIZE - 1)
+#define TW_LEVELS	4
+/* Longest delay (in ticks) a timer can be queued with */
+#define TW_MAX_TICKS	((1UL << (TW_LEVEL_BITS * TW_LEVELS)) - 1)
+
+struct wheel_timer;
+typedef void (*wheel_timer_func_t) (struct wheel_timer *timer);
+
+struct wheel_timer {
+	struct list_head node;
+	/* Expiry tick on the wheel of `cpuid` */
+	u64 expire;
+	/* CPU whose wheel the timer is queued on, -1 if not queued */
+	s32 cpuid;
+	/* Called with the timer already removed from the wheel */
+	wheel_timer_func_t func;
+};
+
+struct timer_wheel {
+	/* Ticks handled on this CPU so far */
+	u64 now;
+	struct list_head slots[TW_LEVELS][TW_LEVEL_SIZE];
+};
+
+void timer_wheel_init(void);
+void timer_wheel_tick(void);
+
+void wheel_timer_init(struct wheel_timer *timer, wheel_timer_func_t func);
+void wheel_timer_add(struct wheel_timer *timer, u64 ticks);
+int wheel_timer_cancel(struct wheel_timer *timer);
+
+static inline bool wheel_timer_pending(struct wheel_timer *timer)
+{
+	return timer->cpuid >= 0;
+}
@@ -18,6 +18,7 @@
 #include <common/mm.h>
 #include <common/kprint.h>
 #include <common/fs.h>
+#include <common/lock.h>
 #include "syscall_num.h"
 
 void sys_debug(long arg)
@@ -65,6 +66,7 @@ const void *syscall_table[NR_SYSCALL] = {
 
 	[SYS_getc] = sys_getc,
 	[SYS_yield] = sys_yield,
+	[SYS_sleep] = sys_sleep,
 	[SYS_create_device_pmo] = sys_create_device_pmo,
 	[SYS_unmap_pmo] = sys_unmap_pmo,
 	[SYS_create_thread] = sys_create_thread,
@@ -78,10 +80,24 @@ const void *syscall_table[NR_SYSCALL] = {
 	 * Add syscall
 	 */
 	[SYS_ipc_reg_call]=sys_ipc_reg_call,
+	[SYS_ipc_fast_call] = sys_ipc_fast_call,
+	[SYS_ipc_fast_return] = sys_ipc_fast_return,
 	[SYS_cap_copy_to] = sys_cap_copy_to,
 	[SYS_cap_copy_from] = sys_cap_copy_from,
 	[SYS_set_affinity] = sys_set_affinity,
 	[SYS_get_affinity] = sys_get_affinity,
+	[SYS_set_time_slice] = sys_set_time_slice,
+	[SYS_futex_wait] = sys_futex_wait,
+	[SYS_futex_wake] = sys_futex_wake,
+	[SYS_create_notifc] = sys_create_notifc,
+	[SYS_wait] = sys_wait,
+	[SYS_notify] = sys_notify,
+	[SYS_ipc_notify] = sys_ipc_notify,
+	[SYS_ipc_wait] = sys_ipc_wait,
+	[SYS_ipc_close] = sys_ipc_close,
+	[SYS_ipc_publish] = sys_ipc_publish,
+	[SYS_ipc_lookup] = sys_ipc_lookup,
+	[SYS_ipc_unpublish] = sys_ipc_unpublish,
 	/* 
 	 * Lab4 - exercise 9
 	 * Add syscall
@@ -94,8 +110,66 @@ const void *syscall_table[NR_SYSCALL] = {
 	[SYS_read_pmo] = sys_read_pmo,
 	[SYS_transfer_caps] = sys_transfer_caps,
 
+	[SYS_top] = sys_top,
+
 	/* TMP FS */
 	[SYS_fs_load_cpio] = sys_fs_load_cpio,
 
 	[SYS_debug] = sys_debug
 };
+
+/*
+ * Syscalls which only touch state guarded by finer-grained locks (the
+ * allocators, the vmspace lock and the slot table locks) run without the
+ * big kernel lock. Everything that blocks, schedules or manipulates
+ * threads and IPC connections still takes it.
+ */
+static const bool syscall_no_bkl[NR_SYSCALL] = {
+	[SYS_putc] = true,
+	[SYS_getc] = true,
+	[SYS_get_cpu_id] = true,
+	[SYS_create_pmo] = true,
+	[SYS_create_device_pmo] = true,
+	[SYS_create_pmos] = true,
+	[SYS_map_pmo] = true,
+	[SYS_map_pmos] = true,
+	[SYS_unmap_pmo] = true,
+	[SYS_write_pmo] = true,
+	[SYS_read_pmo] = true,
+	[SYS_handle_brk] = true,
+	[SYS_cap_copy_to] = true,
+	[SYS_cap_copy_from] = true,
+	[SYS_transfer_caps] = true,
+	[SYS_debug] = true,
+};
+
+/*
+ * Syscalls taking the fast entry path in sync_el0_64.
+ * SYSCALL_FAST_LEAF ones must not take the big kernel lock, switch
+ * threads, fault on user memory or read the saved context of the caller,
+ * which is only partially saved. sys_yield and the other IPC calls switch
+ * threads and keep the full path.
+ * SYSCALL_FAST_IPC ones are the register IPC calls (ipc_call.c): x9-x18
+ * are not saved, the rest of the caller context is, and they return the
+ * context to eret to with the big kernel lock held.
+ */
+const u8 syscall_fast[NR_SYSCALL] = {
+	[SYS_putc] = SYSCALL_FAST_LEAF,
+	[SYS_getc] = SYSCALL_FAST_LEAF,
+	[SYS_get_cpu_id] = SYSCALL_FAST_LEAF,
+	[SYS_ipc_fast_call] = SYSCALL_FAST_IPC,
+	[SYS_ipc_fast_return] = SYSCALL_FAST_IPC,
+};
+
+/*
+ * Called by el0_syscall before dispatching syscall `sysno`.
+ * Returns whether the big kernel lock is taken and must be released
+ * after the syscall returns.
+ */
+bool syscall_lock_kernel(u64 sysno)
+{
+	if (sysno < NR_SYSCALL && syscall_no_bkl[sysno])
+		return false;
+	lock_kernel();
+	return true;
+}
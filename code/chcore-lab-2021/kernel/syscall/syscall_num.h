@@ -14,6 +14,11 @@
 
 #define NR_SYSCALL   256
 
+/* Values of syscall_fast[], see sync_el0_64 */
+#define SYSCALL_FAST_LEAF	1
+#define SYSCALL_FAST_IPC	2
+
+#ifndef __ASM__
 void sys_exit(void);
 void sys_create_pmo(void);
 void sys_map_pmo(void);
@@ -21,6 +26,7 @@ void sys_handle_brk(void);
 /* lab3 syscalls finished */
 
 void sys_yield(void);
+void sys_sleep(void);
 void sys_create_device_pmo(void);
 void sys_create_thread(void);
 void sys_create_process(void);
@@ -29,6 +35,15 @@ void sys_cap_copy_from(void);
 void sys_unmap_pmo(void);
 void sys_set_affinity(void);
 void sys_get_affinity(void);
+void sys_set_time_slice(void);
+void sys_futex_wait(void);
+void sys_futex_wake(void);
+
+void sys_create_notifc(void);
+void sys_wait(void);
+void sys_notify(void);
+
+void sys_top(void);
 
 void sys_create_pmos(void);
 void sys_map_pmos(void);
@@ -41,6 +56,15 @@ void sys_register_client(void);
 void sys_ipc_call(void);
 void sys_ipc_reg_call(void);
 void sys_ipc_return(void);
+void sys_ipc_fast_call(void);
+void sys_ipc_fast_return(void);
+void sys_ipc_notify(void);
+void sys_ipc_wait(void);
+void sys_ipc_close(void);
+void sys_ipc_publish(void);
+void sys_ipc_lookup(void);
+void sys_ipc_unpublish(void);
+#endif				/* __ASM__ */
 
 #define SYS_putc				0
 #define SYS_getc				1
@@ -62,10 +86,24 @@ void sys_ipc_return(void);
 #define SYS_set_affinity                        18
 #define SYS_get_affinity                        19
 #define SYS_create_device_pmo			20
+#define SYS_set_time_slice			21
+#define SYS_futex_wait				22
+#define SYS_futex_wake				23
+#define SYS_create_notifc			24
+#define SYS_wait				25
+#define SYS_notify				26
+#define SYS_ipc_notify				27
+#define SYS_ipc_wait				28
+#define SYS_ipc_close				29
+#define SYS_ipc_publish				30
+#define SYS_ipc_lookup				31
+#define SYS_ipc_unpublish			32
 
 /* Lab4 specfic */
 #define SYS_get_cpu_id                          50
 #define SYS_ipc_reg_call                        51
+#define SYS_ipc_fast_call                       52
+#define SYS_ipc_fast_return                     53
 
 #define SYS_create_pmos                         101
 #define SYS_map_pmos                            102
@@ -75,5 +113,6 @@ void sys_ipc_return(void);
 
 #define SYS_handle_brk				201
 
+#define SYS_top					252
 #define SYS_fs_load_cpio			253
 #define SYS_debug			        255
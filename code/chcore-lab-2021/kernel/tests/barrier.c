@@ -50,7 +50,8 @@ void global_barrier_primary(void)
 	for (i = 0; i < PLAT_CPU_NUM; i++) {
 		if (i == cpu_id)
 			continue;
-		while (cpu_barrier[i] != barrier_num + 1) ;
+		smp_cond_load_acquire_64(&cpu_barrier[i],
+					 VAL == barrier_num + 1);
 	}
 	cpu_barrier[cpu_id] = barrier_num + 1;
 	asm volatile ("dsb sy");
@@ -63,6 +64,7 @@ void global_barrier_secondary(void)
 
 	barrier_num = cpu_barrier[cpu_id];
 	cpu_barrier[cpu_id]++;
-	while (cpu_barrier[PRIMARY_CPU_ID] != barrier_num + 1) ;
+	smp_cond_load_acquire_64(&cpu_barrier[PRIMARY_CPU_ID],
+				 VAL == barrier_num + 1);
 	asm volatile ("dsb sy");
 }
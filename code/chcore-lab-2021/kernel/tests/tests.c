@@ -11,6 +11,11 @@ void init_test(void)
 	global_barrier_init();
 	ret = lock_init(&test_lock);
 	BUG_ON(ret != 0);
+	ret = lock_init(&test_inner_lock);
+	BUG_ON(ret != 0);
+	ret = rwlock_init(&test_rwlock);
+	BUG_ON(ret != 0);
+	seqlock_init(&test_seqlock);
 }
 
 void run_test(bool is_bsp)
@@ -19,7 +24,11 @@ void run_test(bool is_bsp)
 		kinfo("[ChCore] kernel tests\n");
 
 	tst_mutex(is_bsp);
+	tst_mutex_nested(is_bsp);
+	tst_rwlock(is_bsp);
 	tst_big_lock(is_bsp);
+	tst_kmalloc(is_bsp);
+	tst_ipi(is_bsp);
 
 	tst_sched_cooperative(is_bsp);
 	tst_sched_preemptive(is_bsp);
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <common/lock.h>
+#include <common/rwlock.h>
 #include <tests/barrier.h>
 
 extern struct lock test_lock;
+extern struct lock test_inner_lock;
+extern struct rwlock test_rwlock;
+extern struct seqlock test_seqlock;
 
 void init_test(void);
 void run_test(bool);
@@ -12,8 +16,20 @@ void run_test(bool);
  * Locking
  */
 void tst_mutex(bool);
+void tst_mutex_nested(bool);
+void tst_rwlock(bool);
 void tst_big_lock(bool);
 
+/**
+ * Memory allocators
+ */
+void tst_kmalloc(bool);
+
+/**
+ * Inter-processor interrupts
+ */
+void tst_ipi(bool);
+
 /**
  * Scheduler
  */
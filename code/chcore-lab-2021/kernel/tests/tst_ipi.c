@@ -0,0 +1,64 @@
+#include <common/smp.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <common/sync.h>
+#include <exception/ipi.h>
+
+#include <tests/tests.h>
+
+#define IPI_TEST_NUM 1000
+#define IPI_CPU_MASK ((1UL << PLAT_CPU_NUM) - 1)
+
+static volatile u64 ipi_test_count[PLAT_CPU_NUM];
+static volatile u64 ipi_call_finished;
+static volatile u64 ipi_tlb_finished;
+
+static void ipi_test_func(void *arg)
+{
+	u32 cpuid = smp_get_cpu_id();
+
+	BUG_ON(cpuid != (u64)arg);
+	ipi_test_count[cpuid]++;
+}
+
+/*
+ * IRQs are masked here, so a CPU done with its own requests keeps serving
+ * the others instead of waiting in global_barrier.
+ */
+static void ipi_test_barrier(volatile u64 *finished)
+{
+	atomic_fetch_add_64(finished, 1);
+	while (*finished < PLAT_CPU_NUM)
+		ipi_poll();
+}
+
+/*
+ * Every CPU calls a function on its neighbour, which in turn is waiting
+ * for its own neighbour, then all CPUs shoot down the TLBs of all others.
+ */
+void tst_ipi(bool is_bsp)
+{
+	u32 cpuid = smp_get_cpu_id();
+	u32 target = (cpuid + 1) % PLAT_CPU_NUM;
+	int i;
+
+	if (is_bsp)
+		unlock_kernel();
+	global_barrier(is_bsp);
+
+	for (i = 0; i < IPI_TEST_NUM; i++)
+		BUG_ON(smp_call_function(target, ipi_test_func,
+					 (void *)(u64)target, true));
+	ipi_test_barrier(&ipi_call_finished);
+	BUG_ON(ipi_test_count[cpuid] != IPI_TEST_NUM);
+
+	for (i = 0; i < IPI_TEST_NUM; i++)
+		tlb_shootdown(IPI_CPU_MASK);
+	ipi_test_barrier(&ipi_tlb_finished);
+
+	global_barrier(is_bsp);
+	if (is_bsp) {
+		lock_kernel();
+		printk("pass tst_ipi\n");
+	}
+}
@@ -0,0 +1,52 @@
+#include <common/smp.h>
+#include <common/kprint.h>
+#include <common/macro.h>
+#include <common/kmalloc.h>
+
+#include <tests/tests.h>
+
+#define MM_TEST_ROUND 100
+#define MM_TEST_OBJS 32
+
+/* slab sizes, a buddy page and a multi-page block */
+static const u64 mm_test_sizes[] = { 32, 100, 512, 2048, 4096, 3 * 4096 };
+
+/*
+ * Every CPU allocates and frees concurrently without the big kernel lock
+ * and tags its objects. A block handed out twice gets its tag overwritten.
+ */
+void tst_kmalloc(bool is_bsp)
+{
+	u64 *objs[MM_TEST_OBJS];
+	u32 cpuid = smp_get_cpu_id();
+	u64 size, tag, i;
+	int round, j;
+
+	if (is_bsp)
+		unlock_kernel();
+	global_barrier(is_bsp);
+
+	for (round = 0; round < MM_TEST_ROUND; round++) {
+		size = mm_test_sizes[round % (sizeof(mm_test_sizes) /
+					      sizeof(mm_test_sizes[0]))];
+		for (j = 0; j < MM_TEST_OBJS; j++) {
+			objs[j] = kmalloc(size);
+			BUG_ON(objs[j] == NULL);
+			tag = ((u64)cpuid << 32) | (round << 16) | j;
+			for (i = 0; i < size / sizeof(u64); i++)
+				objs[j][i] = tag;
+		}
+		for (j = 0; j < MM_TEST_OBJS; j++) {
+			tag = ((u64)cpuid << 32) | (round << 16) | j;
+			for (i = 0; i < size / sizeof(u64); i++)
+				BUG_ON(objs[j][i] != tag);
+			kfree(objs[j]);
+		}
+	}
+
+	global_barrier(is_bsp);
+	if (is_bsp) {
+		lock_kernel();
+		printk("pass tst_kmalloc\n");
+	}
+}
@@ -11,6 +11,9 @@
 struct lock test_lock;
 unsigned long mutex_test_count = 0;
 unsigned long big_lock_test_count = 0;
+/* Nested lock test */
+struct lock test_inner_lock;
+unsigned long nested_test_count = 0;
 
 void tst_mutex(bool is_bsp)
 {
@@ -35,6 +38,84 @@ void tst_mutex(bool is_bsp)
 	}
 }
 
+/*
+ * Take a second lock while holding the first one, so a CPU which holds a
+ * lock also queues up for another one.
+ */
+void tst_mutex_nested(bool is_bsp)
+{
+	global_barrier(is_bsp);
+
+	for (int i = 0; i < LOCK_TEST_NUM; i++) {
+		lock(&test_lock);
+		lock(&test_inner_lock);
+		nested_test_count++;
+		unlock(&test_inner_lock);
+		unlock(&test_lock);
+		/* the inner lock alone races with the nested acquisitions */
+		lock(&test_inner_lock);
+		nested_test_count++;
+		unlock(&test_inner_lock);
+	}
+
+	global_barrier(is_bsp);
+	BUG_ON(nested_test_count != 2 * PLAT_CPU_NUM * LOCK_TEST_NUM);
+	global_barrier(is_bsp);
+	if (is_bsp) {
+		printk("pass tst_mutex_nested\n");
+	}
+}
+
+/* Readers check that writers always update both values together */
+struct rwlock test_rwlock;
+struct seqlock test_seqlock;
+volatile unsigned long rw_test_a = 0, rw_test_b = 0;
+volatile unsigned long seq_test_a = 0, seq_test_b = 0;
+
+void tst_rwlock(bool is_bsp)
+{
+	unsigned long a, b;
+	u32 seq;
+
+	global_barrier(is_bsp);
+
+	for (int i = 0; i < LOCK_TEST_NUM; i++) {
+		if (i % 4 == 0) {
+			write_lock(&test_rwlock);
+			rw_test_a++;
+			rw_test_b++;
+			write_unlock(&test_rwlock);
+
+			write_seqlock(&test_seqlock);
+			seq_test_a++;
+			seq_test_b++;
+			write_sequnlock(&test_seqlock);
+		} else {
+			if (i % 4 == 1)
+				while (read_try_lock(&test_rwlock) != 0) ;
+			else
+				read_lock(&test_rwlock);
+			BUG_ON(rw_test_a != rw_test_b);
+			read_unlock(&test_rwlock);
+
+			do {
+				seq = read_seqbegin(&test_seqlock);
+				a = seq_test_a;
+				b = seq_test_b;
+			} while (read_seqretry(&test_seqlock, seq));
+			BUG_ON(a != b);
+		}
+	}
+
+	global_barrier(is_bsp);
+	BUG_ON(rw_test_a != PLAT_CPU_NUM * LOCK_TEST_NUM / 4);
+	BUG_ON(seq_test_a != PLAT_CPU_NUM * LOCK_TEST_NUM / 4);
+	global_barrier(is_bsp);
+	if (is_bsp) {
+		printk("pass tst_rwlock\n");
+	}
+}
+
 void tst_big_lock(bool is_bsp)
 {
 	int i;
@@ -5,6 +5,7 @@
 #include <process/thread.h>
 #include <sched/context.h>
 #include <sched/sched.h>
+#include <sched/timer_wheel.h>
 #include <tests/tests.h>
 
 #define TEST_NUM 1
@@ -13,8 +14,6 @@
 volatile int sched_start_flag = 0;
 volatile int sched_finish_flag = 0;
 
-extern struct list_head rr_ready_queue[PLAT_CPU_NUM];
-
 static void atomic_sched(void)
 {
 	lock(&test_lock);
@@ -107,7 +106,7 @@ void tst_sched_param(bool is_bsp)
 			BUG_ON(!sched_enqueue(threads[0]));
 			threads[0]->thread_ctx = thread_ctx;
 
-			BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+			BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 		}
 		{
 			threads[0]->thread_ctx->state = TS_READY;
@@ -146,7 +145,7 @@ void tst_sched_param(bool is_bsp)
 				       TS_INTER);
 			}
 
-			BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+			BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 		}
 	}
 
@@ -155,9 +154,9 @@ void tst_sched_param(bool is_bsp)
 		BUG_ON(idle_thread->thread_ctx->type != TYPE_IDLE);
 
 		{
-			BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+			BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 			BUG_ON(sched_enqueue(idle_thread));
-			BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+			BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 		}
 
 		{
@@ -167,7 +166,7 @@ void tst_sched_param(bool is_bsp)
 			thread = sched_choose_thread();
 			BUG_ON(thread != threads[0]);
 
-			BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+			BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 		}
 
 		{
@@ -223,7 +222,7 @@ void tst_sched_param(bool is_bsp)
 		BUG_ON(current_thread != threads[3]);
 		current_thread = NULL;
 
-		BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+		BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 	}
 
 	for (i = 0; i < local_thread_num; i++) {
@@ -369,10 +368,67 @@ void tst_sched_timer(bool is_bsp)
 	global_barrier(is_bsp);
 }
 
+void tst_sched_sleep(bool is_bsp)
+{
+	int i = 0;
+	u64 tick = 0;
+	u32 local_thread_num = 4;
+	struct thread *threads[4];
+	/* Cover level 0 and the cascades from level 1 and level 2 */
+	u64 delays[4] = { 1, TW_LEVEL_SIZE - 1, TW_LEVEL_SIZE + 3,
+		TW_LEVEL_SIZE * TW_LEVEL_SIZE + 5
+	};
+
+	for (i = 0; i < local_thread_num; i++) {
+		threads[i] = create_test_thread(i, NO_AFF);
+		init_list_head(&threads[i]->notification_queue_node);
+		wheel_timer_init(&threads[i]->wait_timer, sched_wait_timeout);
+		threads[i]->thread_ctx->state = TS_WAITING;
+		wheel_timer_add(&threads[i]->wait_timer, delays[i]);
+	}
+	BUG_ON(current_thread);
+
+	global_barrier(is_bsp);
+
+	for (tick = 1; tick <= delays[local_thread_num - 1]; tick++) {
+		timer_wheel_tick();
+		for (i = 0; i < local_thread_num; i++) {
+			if (tick >= delays[i])
+				BUG_ON(threads[i]->thread_ctx->state !=
+				       TS_READY);
+			else
+				BUG_ON(threads[i]->thread_ctx->state !=
+				       TS_WAITING);
+		}
+	}
+
+	/* Woken up in the order of expiry */
+	for (i = 0; i < local_thread_num; i++) {
+		BUG_ON(sched_choose_thread() != threads[i]);
+		BUG_ON(wheel_timer_pending(&threads[i]->wait_timer));
+		free_test_thread(threads[i]);
+	}
+
+	/* A cancelled timer never fires */
+	threads[0] = create_test_thread(0, NO_AFF);
+	init_list_head(&threads[0]->notification_queue_node);
+	wheel_timer_init(&threads[0]->wait_timer, sched_wait_timeout);
+	threads[0]->thread_ctx->state = TS_WAITING;
+	wheel_timer_add(&threads[0]->wait_timer, 1);
+	BUG_ON(wheel_timer_cancel(&threads[0]->wait_timer));
+	BUG_ON(wheel_timer_cancel(&threads[0]->wait_timer) == 0);
+	timer_wheel_tick();
+	BUG_ON(threads[0]->thread_ctx->state != TS_WAITING);
+	free_test_thread(threads[0]);
+
+	global_barrier(is_bsp);
+}
+
 void tst_sched_preemptive(bool is_bsp)
 {
 	tst_sched_budget(is_bsp);
 	tst_sched_timer(is_bsp);
+	tst_sched_sleep(is_bsp);
 
 	if (is_bsp) {
 		printk("pass tst_sched_preemptive\n");
@@ -399,7 +455,7 @@ void tst_sched_aff_param(bool is_bsp)
 	BUG_ON(idle_thread->thread_ctx->type != TYPE_IDLE);
 
 	free_test_thread(thread);
-	BUG_ON(!list_empty(&rr_ready_queue[cpuid]));
+	BUG_ON(!list_empty(&cpu_info[cpuid].rr_ready_queue));
 
 	global_barrier(is_bsp);
 }
@@ -424,7 +480,7 @@ void tst_sched_aff(bool is_bsp)
 		}
 		for (i = 0; i < PLAT_CPU_NUM; i++) {
 			if (i != cpuid)
-				BUG_ON(!list_empty(&rr_ready_queue[i]));
+				BUG_ON(!list_empty(&cpu_info[i].rr_ready_queue));
 		}
 
 		threads[0]->thread_ctx->sc->budget = 0;
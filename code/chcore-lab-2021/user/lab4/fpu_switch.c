@@ -0,0 +1,70 @@
+#include <lib/print.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+
+#define PRIO 255
+#define THREAD_NUM 3
+#define ITERATION 1000
+
+volatile u64 errors = 0;
+volatile u32 finished = 0;
+
+/*
+ * Fill some caller and callee saved SIMD registers with `pattern`, yield
+ * to the other threads on the CPU and return what differs afterwards.
+ */
+static u64 simd_yield_check(u64 pattern)
+{
+	u64 diff;
+
+	asm volatile ("dup	v0.2d, %[p]\n"
+		      "dup	v8.2d, %[p]\n"
+		      "dup	v31.2d, %[p]\n"
+		      "mov	x8, %[nr]\n"
+		      "svc	#0\n"
+		      "mov	%[d], v0.d[1]\n"
+		      "eor	%[d], %[d], %[p]\n"
+		      "mov	x9, v8.d[0]\n"
+		      "eor	x9, x9, %[p]\n"
+		      "orr	%[d], %[d], x9\n"
+		      "mov	x9, v31.d[1]\n"
+		      "eor	x9, x9, %[p]\n"
+		      "orr	%[d], %[d], x9\n"
+		      : [d] "=&r"(diff)
+		      : [p] "r"(pattern), [nr] "i"(SYS_yield)
+		      : "x0", "x8", "x9", "v0", "v8", "v31", "memory");
+	return diff;
+}
+
+void *thread_routine(void *arg)
+{
+	u64 thread_id = (u64) arg;
+	u64 pattern;
+	int i;
+
+	for (i = 0; i < ITERATION; i++) {
+		pattern = (thread_id + 1) * 0x0101010101010101UL + i;
+		/* diff is 0 if every register still holds the pattern */
+		if (simd_yield_check(pattern) != 0)
+			__atomic_fetch_add(&errors, 1, __ATOMIC_SEQ_CST);
+	}
+
+	__atomic_fetch_add(&finished, 1, __ATOMIC_SEQ_CST);
+	usys_exit(0);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	u64 thread_i;
+
+	/* All on one CPU so that every yield switches between them */
+	for (thread_i = 0; thread_i < THREAD_NUM; ++thread_i)
+		create_thread(thread_routine, thread_i, PRIO, 1);
+
+	while (finished != THREAD_NUM)
+		usys_yield();
+
+	printf("fpu switch errors = %lu\n", errors);
+	return 0;
+}
@@ -0,0 +1,51 @@
+#include <lib/print.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+#include <lib/mutex.h>
+
+#define PRIO 255
+#define THREAD_NUM 4
+#define ITERATION 1000
+
+struct mutex counter_lock;
+volatile u64 counter = 0;
+volatile u32 finished = 0;
+
+void *thread_routine(void *arg)
+{
+	int i;
+
+	for (i = 0; i < ITERATION; i++) {
+		mutex_lock(&counter_lock);
+		counter++;
+		/* Give up the CPU while holding the lock to force contention */
+		if (i % 100 == 0)
+			usys_yield();
+		mutex_unlock(&counter_lock);
+	}
+
+	mutex_lock(&counter_lock);
+	finished++;
+	mutex_unlock(&counter_lock);
+	usys_futex_wake((u32 *)&finished, 1);
+	usys_exit(0);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	u64 thread_i;
+	u32 done;
+
+	mutex_init(&counter_lock);
+	for (thread_i = 0; thread_i < THREAD_NUM; ++thread_i)
+		create_thread(thread_routine, thread_i, PRIO, thread_i);
+
+	/* Block until every worker has finished */
+	while ((done = finished) != THREAD_NUM)
+		usys_futex_wait((u32 *)&finished, done, 0);
+
+	printf("counter = %lu, expected %lu\n", counter,
+	       (u64) THREAD_NUM * ITERATION);
+	return 0;
+}
@@ -0,0 +1,275 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/*
+ * Baseline of the IPC paths: null register call, messages of growing
+ * size, cap transfer and connection setup/teardown. Each is timed call by
+ * call with cntpct_el0 and reported as p50/p99/p999 in ns. Every test runs
+ * against a server with its handlers on the caller's CPU (single core) and
+ * one with them on SERVER_CPU (cross core), the client stays on CLIENT_CPU.
+ */
+
+#define CHILD_INFO_VADDR 0xb0000000
+/* Clear of CHILD_THREAD_STACK_BASE */
+#define CONN_BUF_BASE 0x50000000
+#define CLIENT_CPU 0
+#define SERVER_MAIN_CPU 1
+#define SERVER_CPU 3
+
+/* Server side, see ipc_bench_server.c */
+#define BENCH_BUF_SIZE 0x20000
+
+#define WARMUP 100
+#define ROUND 2000
+#define PAYLOAD_MAX 0x10000
+#define CAP_MAX 8
+
+struct server {
+	const char *name;
+	s32 dispatch_cpu;
+	struct info_page *info_page;
+	int thread_cap;
+	ipc_struct_t ipc_struct;
+};
+
+static struct server servers[] = {
+	{ .name = "single-core", .dispatch_cpu = IPC_DISPATCH_CALLER },
+	{ .name = "cross-core", .dispatch_cpu = SERVER_CPU },
+};
+
+#define NR_SERVERS (sizeof(servers) / sizeof(servers[0]))
+
+static u64 samples[ROUND], teardown[ROUND];
+static char payload[PAYLOAD_MAX];
+static const struct {
+	const char *name;
+	u64 size;
+} payloads[] = {
+	{ "8B", 8 }, { "64B", 64 }, { "4KB", 0x1000 }, { "64KB", 0x10000 },
+};
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+static u64 cycles_to_ns(u64 cycles)
+{
+	return cycles * 1000000000UL / read_freq();
+}
+
+static void sort_samples(u64 nr)
+{
+	u64 gap, i, j, tmp;
+
+	for (gap = nr / 2; gap > 0; gap /= 2) {
+		for (i = gap; i < nr; i++) {
+			tmp = samples[i];
+			for (j = i; j >= gap && samples[j - gap] > tmp; j -= gap)
+				samples[j] = samples[j - gap];
+			samples[j] = tmp;
+		}
+	}
+}
+
+/* Percentiles of the samples, in per mille */
+static u64 percentile(u64 nr, u64 pm)
+{
+	u64 idx = nr * pm / 1000;
+
+	return cycles_to_ns(samples[idx < nr ? idx : nr - 1]);
+}
+
+static void report(struct server *server, const char *test, u64 bytes)
+{
+	u64 total = 0, i;
+
+	for (i = 0; i < ROUND; i++)
+		total += samples[i];
+	sort_samples(ROUND);
+
+	printf("[Bench] %s %s: p50 %lu ns, p99 %lu ns, p999 %lu ns",
+	       server->name, test, percentile(ROUND, 500),
+	       percentile(ROUND, 990), percentile(ROUND, 999));
+	if (bytes)
+		printf(", %lu MB/s", bytes * ROUND * read_freq() / total /
+		       (1024 * 1024));
+	printf("\n");
+}
+
+static void bench_null(struct server *server)
+{
+	u64 start;
+	int i, ret;
+
+	for (i = -WARMUP; i < ROUND; i++) {
+		start = read_cycles();
+		ret = ipc_reg_call(&server->ipc_struct, i);
+		if (i >= 0)
+			samples[i] = read_cycles() - start;
+		fail_cond(ret != 0, "null call ret %d\n", ret);
+	}
+	report(server, "null", 0);
+}
+
+static void bench_payload(struct server *server, const char *test, u64 size)
+{
+	ipc_msg_t *ipc_msg;
+	u64 start;
+	int i, ret;
+
+	ipc_msg = ipc_create_msg(&server->ipc_struct, size, 0);
+	for (i = -WARMUP; i < ROUND; i++) {
+		start = read_cycles();
+		ipc_set_msg_data(ipc_msg, payload, 0, size);
+		ret = ipc_call(&server->ipc_struct, ipc_msg);
+		if (i >= 0)
+			samples[i] = read_cycles() - start;
+		fail_cond(ret != size, "%lu bytes call ret %d\n", size, ret);
+	}
+	ipc_destroy_msg(ipc_msg);
+	report(server, test, size);
+}
+
+/* The server keeps every cap it gets, its cap table grows by nr a call */
+static void bench_caps(struct server *server, const char *test, int pmo_cap,
+		       u64 nr)
+{
+	ipc_msg_t *ipc_msg;
+	u64 start, j;
+	int i, ret;
+
+	ipc_msg = ipc_create_msg(&server->ipc_struct, 0, nr);
+	for (i = -WARMUP; i < ROUND; i++) {
+		for (j = 0; j < nr; j++)
+			ipc_set_msg_cap(ipc_msg, j, pmo_cap);
+		start = read_cycles();
+		ret = ipc_call(&server->ipc_struct, ipc_msg);
+		if (i >= 0)
+			samples[i] = read_cycles() - start;
+		fail_cond(ret != 0, "cap call ret %d\n", ret);
+	}
+	ipc_destroy_msg(ipc_msg);
+	report(server, test, 0);
+}
+
+static void bench_conn(struct server *server)
+{
+	struct ipc_vm_config vm_config;
+	u64 start;
+	int i, conn_cap, ret;
+
+	/* After the connections of the servers */
+	vm_config.buf_base_addr = CONN_BUF_BASE + NR_SERVERS * BENCH_BUF_SIZE;
+	for (i = 0; i < ROUND; i++) {
+		vm_config.buf_size = BENCH_BUF_SIZE;
+		start = read_cycles();
+		conn_cap = usys_register_client(server->thread_cap,
+						(u64) & vm_config);
+		samples[i] = read_cycles() - start;
+		fail_cond(conn_cap < 0, "connect ret %d\n", conn_cap);
+
+		start = read_cycles();
+		ret = usys_ipc_close(conn_cap);
+		teardown[i] = read_cycles() - start;
+		fail_cond(ret < 0, "close ret %d\n", ret);
+	}
+	report(server, "connect", 0);
+
+	for (i = 0; i < ROUND; i++)
+		samples[i] = teardown[i];
+	report(server, "close", 0);
+}
+
+static void spawn_server(struct server *server, int idx)
+{
+	struct pmo_map_request pmo_map_reqs[1];
+	struct ipc_vm_config vm_config;
+	int new_process_cap, info_pmo_cap, conn_cap, ret;
+	u64 info_vaddr = CHILD_INFO_VADDR + idx * PAGE_SIZE;
+
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_pmo ret %d\n", info_pmo_cap);
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, info_vaddr,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	server->info_page = (void *)info_vaddr;
+	server->info_page->ready_flag = 0;
+	server->info_page->exit_flag = 0;
+	server->info_page->nr_args = 1;
+	server->info_page->args[0] = server->dispatch_cpu;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_bench_server.bin", &new_process_cap,
+		    &server->thread_cap, pmo_map_reqs, 1, NULL, 0,
+		    SERVER_MAIN_CPU);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (server->info_page->ready_flag != 1)
+		usys_yield();
+
+	/* ipc_register_client would map every buffer at the same place */
+	vm_config.buf_base_addr = CONN_BUF_BASE + idx * BENCH_BUF_SIZE;
+	vm_config.buf_size = BENCH_BUF_SIZE;
+	conn_cap = usys_register_client(server->thread_cap, (u64) & vm_config);
+	fail_cond(conn_cap < 0, "usys_register_client ret %d\n", conn_cap);
+
+	server->ipc_struct.conn_cap = conn_cap;
+	server->ipc_struct.shared_buf = vm_config.buf_base_addr;
+	server->ipc_struct.shared_buf_len = vm_config.buf_size;
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int i, j, pmo_cap, ret;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	ret = usys_set_affinity(-1, CLIENT_CPU);
+	fail_cond(ret != 0, "usys_set_affinity ret %d\n", ret);
+	usys_yield();
+
+	for (i = 0; i < PAYLOAD_MAX; i++)
+		payload[i] = i;
+	pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(pmo_cap < 0, "usys_create_pmo ret %d\n", pmo_cap);
+
+	for (i = 0; i < NR_SERVERS; i++)
+		spawn_server(&servers[i], i);
+
+	for (i = 0; i < NR_SERVERS; i++) {
+		bench_null(&servers[i]);
+		for (j = 0; j < sizeof(payloads) / sizeof(payloads[0]); j++)
+			bench_payload(&servers[i], payloads[j].name,
+				      payloads[j].size);
+		bench_caps(&servers[i], "1 cap", pmo_cap, 1);
+		bench_caps(&servers[i], "8 caps", pmo_cap, CAP_MAX);
+		bench_conn(&servers[i]);
+	}
+
+	for (i = 0; i < NR_SERVERS; i++)
+		servers[i].info_page->exit_flag = 1;
+	return 0;
+}
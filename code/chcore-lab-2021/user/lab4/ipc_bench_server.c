@@ -0,0 +1,68 @@
+#include <lib/bug.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/* See ipc_bench.c */
+#define BENCH_STACK_BASE 0x7000000
+#define BENCH_STACK_SIZE 0x1000
+#define BENCH_BUF_BASE 0x20000000
+#define BENCH_BUF_SIZE 0x20000
+#define BENCH_CONN_MAX 64
+#define BENCH_HANDLERS 4
+
+/* Keeps the reads of the payload */
+static volatile u64 sink;
+
+/*
+ * Register calls get their argument instead of a message: answer them
+ * right away. Messages have their payload read, the reply is its length.
+ */
+void ipc_dispatcher(ipc_msg_t * ipc_msg)
+{
+	u64 arg = (u64) ipc_msg;
+	u64 *data, sum = 0, i;
+
+	if (arg < BENCH_BUF_BASE ||
+	    arg >= BENCH_BUF_BASE + BENCH_CONN_MAX * BENCH_BUF_SIZE) {
+		ipc_return(0);
+	} else {
+		data = (u64 *) ipc_get_msg_data(ipc_msg);
+		for (i = 0; i < ipc_msg->data_len / sizeof(u64); i++)
+			sum += data[i];
+		sink = sum;
+		ipc_return(ipc_msg->data_len);
+	}
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret;
+	void *info_page_addr;
+	struct info_page *info_page;
+	/* Large enough for a 64KB payload in the shared buffer */
+	struct ipc_vm_config vm_config = {
+		.stack_base_addr = BENCH_STACK_BASE,
+		.stack_size = BENCH_STACK_SIZE,
+		.buf_base_addr = BENCH_BUF_BASE,
+		.buf_size = BENCH_BUF_SIZE,
+	};
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+	info_page = (struct info_page *)info_page_addr;
+
+	ret = usys_register_server((u64) ipc_dispatcher, BENCH_HANDLERS,
+				   (u64) & vm_config, (s32) info_page->args[0]);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/errno.h>
+#include <lib/ipc.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+
+/*
+ * Short-lived connections, all with the same buffer in the client. The
+ * server runs out of room for buffers after about 3000 of them unless
+ * closing gives their slots back.
+ */
+#define CONN_ROUNDS 4096
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int info_pmo_cap;
+	int new_process_cap, new_thread_cap;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	ipc_struct_t client_ipc_struct;
+	int i;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_ret ret %d\n", ret);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, CHILD_INFO_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)CHILD_INFO_VADDR;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 0;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_reg_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+
+	for (i = 0; i < CONN_ROUNDS; i++) {
+		ret = ipc_register_client(new_thread_cap, &client_ipc_struct);
+		fail_cond(ret < 0, "connection %d fails\n", i);
+
+		/* A fresh buffer reads as zero, touching it populates it */
+		fail_cond(*(int *)client_ipc_struct.shared_buf != 0,
+			  "connection %d: stale buffer\n", i);
+		*(int *)client_ipc_struct.shared_buf = i + 1;
+
+		/* The server echoes the argument back */
+		ret = ipc_reg_call(&client_ipc_struct, i + 1);
+		fail_cond(ret != i + 1, "connection %d returns %d\n", i, ret);
+
+		ret = ipc_close_client(&client_ipc_struct);
+		fail_cond(ret < 0, "close %d ret %d\n", i, ret);
+	}
+
+	ret = ipc_reg_call(&client_ipc_struct, 1);
+	fail_cond(ret != -ECAPBILITY, "call on a closed connection ret %d\n",
+		  ret);
+	ret = ipc_close_client(&client_ipc_struct);
+	fail_cond(ret != -ECAPBILITY, "closing twice ret %d\n", ret);
+
+	printf("[Client] %d connections opened and closed\n", CONN_ROUNDS);
+	info_page->exit_flag = 1;
+	return 0;
+}
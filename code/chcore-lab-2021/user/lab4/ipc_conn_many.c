@@ -0,0 +1,72 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+
+/* More connections than the server has handler threads, or had before */
+#define CONN_NUM 40
+#define CONN_BUF_BASE 0x10000000
+#define CONN_BUF_SIZE 0x1000
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int info_pmo_cap;
+	int new_process_cap, new_thread_cap;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	struct ipc_vm_config vm_config;
+	int conn_caps[CONN_NUM];
+	int i;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_ret ret %d\n", ret);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, CHILD_INFO_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)CHILD_INFO_VADDR;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 0;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_reg_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+
+	/* Each connection gets its own shared buffer in the client */
+	for (i = 0; i < CONN_NUM; i++) {
+		vm_config.buf_base_addr = CONN_BUF_BASE + i * CONN_BUF_SIZE;
+		vm_config.buf_size = CONN_BUF_SIZE;
+		conn_caps[i] = usys_register_client(new_thread_cap,
+						    (u64) & vm_config);
+		fail_cond(conn_caps[i] < 0, "connection %d fails: %d\n", i,
+			  conn_caps[i]);
+	}
+
+	/* The server echoes the argument back */
+	for (i = 0; i < CONN_NUM; i++) {
+		ret = usys_ipc_reg_call(conn_caps[i], i + 1);
+		fail_cond(ret != i + 1, "connection %d returns %d\n", i, ret);
+	}
+
+	printf("[Client] %d connections served\n", CONN_NUM);
+	info_page->exit_flag = 1;
+	return 0;
+}
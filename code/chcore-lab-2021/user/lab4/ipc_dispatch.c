@@ -0,0 +1,156 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+#include <lib/type.h>
+
+/* Info pages of the two servers */
+#define CHILD_INFO_VADDR 0xb0000000
+/* And the client ends of their connections, clear of the thread stacks */
+#define CONN_BUF_BASE 0x50000000
+#define CONN_BUF_SIZE 0x1000
+#define PRIO 255
+
+/*
+ * The same server twice: handlers on the CPU of each caller, or all of
+ * them on SERVER_CPU. Callers run on the other CPUs.
+ */
+#define SERVER_CPU 3
+#define MAX_CLIENTS 3
+#define CALL_NUM 2000
+
+struct server {
+	const char *name;
+	s32 dispatch_cpu;
+	struct info_page *info_page;
+	int conn_cap;
+};
+
+static struct server servers[] = {
+	{ .name = "caller CPU", .dispatch_cpu = IPC_DISPATCH_CALLER },
+	{ .name = "server CPU", .dispatch_cpu = SERVER_CPU },
+};
+
+static volatile u64 started, finished;
+static u64 client_num;
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+static void *client_routine(void *arg)
+{
+	struct server *server = arg;
+	u64 i;
+	int ret;
+
+	__atomic_fetch_add(&started, 1, __ATOMIC_SEQ_CST);
+	while (started != client_num)
+		;
+	for (i = 0; i < CALL_NUM; i++) {
+		ret = usys_ipc_reg_call(server->conn_cap, i);
+		fail_cond(ret < 0, "call %ld ret %d\n", i, ret);
+	}
+	__atomic_fetch_add(&finished, 1, __ATOMIC_SEQ_CST);
+	usys_exit(0);
+	return NULL;
+}
+
+static void spawn_server(struct server *server, int idx)
+{
+	struct pmo_map_request pmo_map_reqs[1];
+	struct ipc_vm_config vm_config;
+	int new_process_cap, new_thread_cap;
+	int info_pmo_cap, ret;
+	u64 info_vaddr = CHILD_INFO_VADDR + idx * PAGE_SIZE;
+
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_pmo ret %d\n", info_pmo_cap);
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, info_vaddr,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	server->info_page = (void *)info_vaddr;
+	server->info_page->ready_flag = 0;
+	server->info_page->exit_flag = 0;
+	server->info_page->nr_args = 1;
+	server->info_page->args[0] = server->dispatch_cpu;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_dispatch_server.bin", &new_process_cap,
+		    &new_thread_cap, pmo_map_reqs, 1, NULL, 0, SERVER_CPU);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (server->info_page->ready_flag != 1)
+		usys_yield();
+
+	vm_config.buf_base_addr = CONN_BUF_BASE + idx * CONN_BUF_SIZE;
+	vm_config.buf_size = CONN_BUF_SIZE;
+	server->conn_cap = usys_register_client(new_thread_cap,
+						(u64) & vm_config);
+	fail_cond(server->conn_cap < 0, "usys_register_client ret %d\n",
+		  server->conn_cap);
+}
+
+/* Every client makes CALL_NUM calls, report the time of one of them */
+static void run(struct server *server, u64 clients)
+{
+	u64 i, start, cycles;
+	int ret;
+
+	started = 0;
+	finished = 0;
+	client_num = clients;
+	start = read_cycles();
+	for (i = 0; i < clients; i++) {
+		ret = create_thread(client_routine, (u64) server, PRIO, i);
+		fail_cond(ret < 0, "create_thread ret %d\n", ret);
+	}
+	while (finished != clients)
+		usys_yield();
+	cycles = read_cycles() - start;
+
+	printf("[Client] %s: %ld client(s), %lu ns/call, %lu calls/ms\n",
+	       server->name, clients,
+	       cycles * 1000000000UL / read_freq() / CALL_NUM,
+	       clients * CALL_NUM * read_freq() / 1000 / cycles);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int i;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	for (i = 0; i < 2; i++)
+		spawn_server(&servers[i], i);
+
+	for (i = 0; i < 2; i++) {
+		run(&servers[i], 1);
+		run(&servers[i], MAX_CLIENTS);
+	}
+
+	for (i = 0; i < 2; i++)
+		servers[i].info_page->exit_flag = 1;
+	return 0;
+}
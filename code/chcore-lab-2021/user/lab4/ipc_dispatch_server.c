@@ -0,0 +1,49 @@
+#include <lib/bug.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/* Data touched by every call, 16KB */
+#define TABLE_WORDS 2048
+
+static u64 table[TABLE_WORDS];
+
+void ipc_dispatcher(ipc_msg_t * ipc_msg)
+{
+	u64 arg = (u64) ipc_msg;
+	u64 sum = 0;
+	int i;
+
+	for (i = 0; i < TABLE_WORDS; i += 8)
+		sum += table[(i + arg) % TABLE_WORDS];
+	ipc_return(sum);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret, i;
+	s32 dispatch_cpu;
+	void *info_page_addr;
+	struct info_page *info_page;
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+	info_page = (struct info_page *)info_page_addr;
+	dispatch_cpu = (s32) info_page->args[0];
+
+	for (i = 0; i < TABLE_WORDS; i++)
+		table[i] = i;
+
+	ret = ipc_register_server_on(ipc_dispatcher, dispatch_cpu);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
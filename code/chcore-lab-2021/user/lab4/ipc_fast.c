@@ -0,0 +1,119 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+
+#define WARMUP 1000
+#define ROUND 10000
+
+/* First word of a request, see ipc_fast_server.c */
+#define OP_REG 0
+#define OP_FAST 1
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+/* Average cost of one round trip in nanoseconds */
+static u64 cycles_to_ns(u64 cycles, u64 nr)
+{
+	return cycles * 1000000000UL / read_freq() / nr;
+}
+
+static void fast_call(ipc_struct_t * icb, u64 * msg)
+{
+	int i;
+
+	msg[0] = OP_FAST;
+	for (i = 1; i < IPC_FAST_MSG_REGS; i++)
+		msg[i] = i * 100;
+	ipc_fast_call(icb, msg);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int info_pmo_cap;
+	int new_process_cap, new_thread_cap;
+	ipc_struct_t client_ipc_struct;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	u64 msg[IPC_FAST_MSG_REGS];
+	u64 start, reg, fast;
+	int i;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_ret ret %d\n", ret);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, CHILD_INFO_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)CHILD_INFO_VADDR;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 0;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_fast_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+
+	ret = ipc_register_client(new_thread_cap, &client_ipc_struct);
+	fail_cond(ret < 0, "ipc_register_client failed\n");
+
+	/* All the message registers make it there and back */
+	fast_call(&client_ipc_struct, msg);
+	fail_cond(msg[0] != 0, "ipc_fast_call returns %ld\n", msg[0]);
+	for (i = 1; i < IPC_FAST_MSG_REGS; i++)
+		fail_cond(msg[i] != i * 100 + 1, "reply word %d is %ld\n", i,
+			  msg[i]);
+
+	for (i = 0; i < WARMUP; i++) {
+		ipc_reg_call(&client_ipc_struct, OP_REG);
+		fast_call(&client_ipc_struct, msg);
+	}
+
+	start = read_cycles();
+	for (i = 0; i < ROUND; i++)
+		ipc_reg_call(&client_ipc_struct, OP_REG);
+	reg = read_cycles() - start;
+
+	start = read_cycles();
+	for (i = 0; i < ROUND; i++)
+		fast_call(&client_ipc_struct, msg);
+	fast = read_cycles() - start;
+
+	printf("ipc_reg_call: %lu ns/round trip\n", cycles_to_ns(reg, ROUND));
+	printf("ipc_fast_call: %lu ns/round trip\n",
+	       cycles_to_ns(fast, ROUND));
+
+	info_page->exit_flag = 1;
+	return 0;
+}
@@ -0,0 +1,52 @@
+#include <lib/bug.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/* First word of a request, see ipc_fast.c */
+#define OP_REG 0
+#define OP_FAST 1
+
+/* Entered with the request in x0-x7 for both kinds of call */
+void ipc_dispatcher(u64 op, u64 a1, u64 a2, u64 a3, u64 a4, u64 a5, u64 a6,
+		    u64 a7)
+{
+	u64 reply[IPC_FAST_MSG_REGS];
+
+	if (op != OP_FAST)
+		ipc_return(0);
+
+	reply[0] = 0;
+	reply[1] = a1 + 1;
+	reply[2] = a2 + 1;
+	reply[3] = a3 + 1;
+	reply[4] = a4 + 1;
+	reply[5] = a5 + 1;
+	reply[6] = a6 + 1;
+	reply[7] = a7 + 1;
+	ipc_fast_return(reply);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret;
+	void *info_page_addr;
+	struct info_page *info_page;
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+
+	ret = ipc_register_fast_server(ipc_dispatcher);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	info_page = (struct info_page *)info_page_addr;
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
@@ -0,0 +1,177 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+#include <lib/type.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+#define GRANT_BUF_VADDR 0xc0000000
+#define GRANT_BUF_SIZE 0x400000		/* 4M */
+#define ROUNDS 16
+#define NO_AFF -1
+
+/* The server marks the last page, which we never touch before the call */
+#define TAIL_MAGIC 0x6772616e74UL
+
+/*
+ * Last round: grant the buffer of a second connection and close it
+ * while the server still uses it. Info page args in both directions.
+ */
+#define CLOSE_ROUND (~0UL)
+#define CLOSE_MAGIC 0x636c6f7365UL
+#define CLOSE_BUF_VADDR 0x50000000
+#define ARG_GRANTED 0
+#define ARG_CLOSED 1
+
+static volatile u64 *args;
+static volatile int close_ret = 1;
+
+/* Close the connection once the server holds its buffer */
+static void *closer_routine(void *arg)
+{
+	while (args[ARG_GRANTED] != 1)
+		usys_yield();
+	close_ret = usys_ipc_close((u32) (u64) arg);
+	args[ARG_CLOSED] = 1;
+	usys_exit(0);
+	return NULL;
+}
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int info_pmo_cap, buf_pmo_cap, close_conn_cap;
+	int new_process_cap, new_thread_cap;
+	ipc_struct_t client_ipc_struct;
+	struct ipc_vm_config close_vm_config = {
+		.buf_base_addr = CLOSE_BUF_VADDR,
+		.buf_size = PAGE_SIZE,
+	};
+	ipc_msg_t *ipc_msg;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	u64 *buf = (u64 *) GRANT_BUF_VADDR;
+	u64 words = (GRANT_BUF_SIZE - PAGE_SIZE) / sizeof(u64);
+	u64 round, i, start, cycles = 0;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_ret ret %d\n", ret);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, CHILD_INFO_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)CHILD_INFO_VADDR;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 2;
+	args = info_page->args;
+	args[ARG_GRANTED] = 0;
+	args[ARG_CLOSED] = 0;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_grant_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+
+	ret = ipc_register_client(new_thread_cap, &client_ipc_struct);
+	fail_cond(ret < 0, "ipc_register_client failed\n");
+
+	/* Populated on demand, the server may touch pages we did not */
+	buf_pmo_cap = usys_create_pmo(GRANT_BUF_SIZE, PMO_ANONYM);
+	fail_cond(buf_pmo_cap < 0, "usys_create_pmo ret %d\n", buf_pmo_cap);
+	ret = usys_map_pmo(SELF_CAP, buf_pmo_cap, GRANT_BUF_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < words; i++)
+			buf[i] = i + round;
+
+		/* The server checks and increments every word in place */
+		ipc_msg = ipc_create_msg(&client_ipc_struct, sizeof(u64), 0);
+		ipc_set_msg_data(ipc_msg, (char *)&round, 0, sizeof(u64));
+		ret = ipc_set_msg_grant(ipc_msg, buf, GRANT_BUF_SIZE,
+					VM_READ | VM_WRITE);
+		fail_cond(ret < 0, "ipc_set_msg_grant ret %d\n", ret);
+
+		start = read_cycles();
+		ret = ipc_call(&client_ipc_struct, ipc_msg);
+		cycles += read_cycles() - start;
+		ipc_destroy_msg(ipc_msg);
+		fail_cond(ret != 0, "round %ld: server ret %d\n", round, ret);
+
+		for (i = 0; i < words; i++)
+			fail_cond(buf[i] != i + round + 1,
+				  "round %ld: word %ld is %lx\n", round, i,
+				  buf[i]);
+		fail_cond(buf[words] != TAIL_MAGIC + round,
+			  "round %ld: tail page not written\n", round);
+	}
+
+	/* A grant larger than the window of the server is refused */
+	ipc_msg = ipc_create_msg(&client_ipc_struct, sizeof(u64), 0);
+	ipc_msg->grant_addr = GRANT_BUF_VADDR;
+	ipc_msg->grant_len = IPC_GRANT_MAX + PAGE_SIZE;
+	ipc_msg->grant_perm = VM_READ;
+	ret = ipc_call(&client_ipc_struct, ipc_msg);
+	fail_cond(ret >= 0, "oversized grant ret %d\n", ret);
+
+	/* The granted pages outlive the connection until the call returns */
+	close_conn_cap = (int)usys_register_client(new_thread_cap,
+						   (u64) & close_vm_config);
+	fail_cond(close_conn_cap < 0, "usys_register_client ret %d\n",
+		  close_conn_cap);
+	*(u64 *) CLOSE_BUF_VADDR = CLOSE_MAGIC;
+	ret = create_thread(closer_routine, close_conn_cap, MAIN_THREAD_PRIO,
+			    NO_AFF);
+	fail_cond(ret < 0, "create_thread ret %d\n", ret);
+
+	round = CLOSE_ROUND;
+	ipc_msg = ipc_create_msg(&client_ipc_struct, sizeof(u64), 0);
+	ipc_set_msg_data(ipc_msg, (char *)&round, 0, sizeof(u64));
+	ret = ipc_set_msg_grant(ipc_msg, (void *)CLOSE_BUF_VADDR, PAGE_SIZE,
+				VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "ipc_set_msg_grant ret %d\n", ret);
+	ret = ipc_call(&client_ipc_struct, ipc_msg);
+	ipc_destroy_msg(ipc_msg);
+	fail_cond(ret != 0, "closed grant: server ret %d\n", ret);
+	fail_cond(close_ret != 0, "close of a granted buffer ret %d\n",
+		  close_ret);
+
+	printf("[Client] %d rounds of %d KB granted, %lu ns/call\n", ROUNDS,
+	       GRANT_BUF_SIZE / 1024,
+	       cycles * 1000000000UL / read_freq() / ROUNDS);
+
+	info_page->exit_flag = 1;
+	return 0;
+}
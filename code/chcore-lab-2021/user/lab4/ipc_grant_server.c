@@ -0,0 +1,70 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/* See ipc_grant.c */
+#define TAIL_MAGIC 0x6772616e74UL
+#define CLOSE_ROUND (~0UL)
+#define CLOSE_MAGIC 0x636c6f7365UL
+#define ARG_GRANTED 0
+#define ARG_CLOSED 1
+
+static volatile u64 *args;
+
+void ipc_dispatcher(ipc_msg_t * ipc_msg)
+{
+	u64 *buf, len, words, round, i;
+
+	round = *(u64 *) ipc_get_msg_data(ipc_msg);
+	buf = ipc_get_msg_grant(ipc_msg, &len);
+	if (round == CLOSE_ROUND) {
+		/* Use the page after the client closed its connection */
+		args[ARG_GRANTED] = 1;
+		while (args[ARG_CLOSED] != 1)
+			usys_yield();
+		if (len != PAGE_SIZE || buf[0] != CLOSE_MAGIC)
+			ipc_return(-1);
+		buf[0]++;
+		ipc_return(0);
+	}
+	if (len <= PAGE_SIZE)
+		ipc_return(-1);
+
+	/* Read and write the pages of the client where they are */
+	words = (len - PAGE_SIZE) / sizeof(u64);
+	for (i = 0; i < words; i++) {
+		if (buf[i] != i + round)
+			ipc_return(-1);
+		buf[i]++;
+	}
+	buf[words] = TAIL_MAGIC + round;
+
+	ipc_return(0);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret;
+	void *info_page_addr;
+	struct info_page *info_page;
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+
+	ret = ipc_register_server(ipc_dispatcher);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	info_page = (struct info_page *)info_page_addr;
+	args = info_page->args;
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
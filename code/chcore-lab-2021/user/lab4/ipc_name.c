@@ -0,0 +1,166 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/errno.h>
+#include <lib/ipc.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+#include <lib/type.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+#define PRIO 255
+#define THREAD_NUM 3
+#define CALL_NUM 100
+
+static ipc_struct_t *main_ipc_struct;
+static volatile int finished;
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+/* Every thread finds the connection of the main thread */
+static void *client_routine(void *arg)
+{
+	ipc_struct_t *ipc_struct;
+	u64 id = (u64) arg;
+	int i, ret;
+
+	ipc_struct = ipc_lookup("echo");
+	fail_cond(ipc_struct != main_ipc_struct,
+		  "thread %ld got another connection\n", id);
+	for (i = 0; i < CALL_NUM; i++) {
+		ret = ipc_reg_call(ipc_struct, id * CALL_NUM + i);
+		fail_cond(ret != id * CALL_NUM + i, "thread %ld call ret %d\n",
+			  id, ret);
+	}
+	__atomic_fetch_add(&finished, 1, __ATOMIC_SEQ_CST);
+	usys_exit(0);
+	return NULL;
+}
+
+/* Info page args of ipc_name_server */
+#define ARG_RIVAL 0
+#define ARG_PUBLISH 1
+#define ARG_UNPUBLISH 2
+/* Rounds to wait for the rival to exit */
+#define EXIT_ROUNDS 10000
+
+static struct info_page *spawn_server(int idx, u64 rival)
+{
+	int new_process_cap, new_thread_cap;
+	int info_pmo_cap, ret;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	u64 info_vaddr = CHILD_INFO_VADDR + idx * PAGE_SIZE;
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_pmo ret %d\n", info_pmo_cap);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, info_vaddr,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)info_vaddr;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 3;
+	info_page->args[ARG_RIVAL] = rival;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_name_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+	return info_page;
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	struct info_page *info_page, *rival_page;
+	ipc_struct_t *rival;
+	u64 start, lookup, cached;
+	int i, ret;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	info_page = spawn_server(0, 0);
+
+	fail_cond(ipc_lookup("none") != NULL, "lookup of an unknown name\n");
+	/* Only registered servers publish */
+	ret = ipc_publish("echo");
+	fail_cond(ret != -EINVAL, "publish from a client ret %d\n", ret);
+
+	/* Names are not stolen by another server */
+	rival_page = spawn_server(1, 1);
+	fail_cond((int)rival_page->args[ARG_PUBLISH] != -EEXIST,
+		  "rival publish ret %d\n", (int)rival_page->args[ARG_PUBLISH]);
+	fail_cond((int)rival_page->args[ARG_UNPUBLISH] != -EPERM,
+		  "rival unpublish ret %d\n",
+		  (int)rival_page->args[ARG_UNPUBLISH]);
+
+	rival = ipc_lookup("rival");
+	fail_cond(rival == NULL, "lookup of the rival failed\n");
+	ret = ipc_reg_call(rival, 1);
+	fail_cond(ret != 1, "rival call ret %d\n", ret);
+
+	/*
+	 * When their server exits, its connections are revoked and its
+	 * names released. The library drops the dead connection.
+	 */
+	rival_page->exit_flag = 1;
+	for (i = 0; i < EXIT_ROUNDS; i++) {
+		ret = ipc_reg_call(rival, 1);
+		if (ret == -ECAPBILITY)
+			break;
+		fail_cond(ret != 1, "rival call ret %d\n", ret);
+		usys_yield();
+	}
+	fail_cond(i == EXIT_ROUNDS, "rival connection still alive\n");
+	fail_cond(ipc_lookup("rival") != NULL, "rival still published\n");
+
+	start = read_cycles();
+	main_ipc_struct = ipc_lookup("echo");
+	lookup = read_cycles() - start;
+	fail_cond(main_ipc_struct == NULL, "lookup failed\n");
+
+	start = read_cycles();
+	fail_cond(ipc_lookup("echo") != main_ipc_struct, "not cached\n");
+	cached = read_cycles() - start;
+
+	for (i = 0; i < THREAD_NUM; i++) {
+		ret = create_thread(client_routine, i, PRIO, i);
+		fail_cond(ret < 0, "create_thread ret %d\n", ret);
+	}
+	while (finished != THREAD_NUM)
+		usys_yield();
+
+	printf("[Client] lookup %lu ns, cached %lu ns\n",
+	       lookup * 1000000000UL / read_freq(),
+	       cached * 1000000000UL / read_freq());
+	printf("[Client] %d threads served through one connection\n",
+	       THREAD_NUM);
+	info_page->exit_flag = 1;
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+#include <lib/bug.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/* See ipc_name.c */
+#define ARG_RIVAL 0
+#define ARG_PUBLISH 1
+#define ARG_UNPUBLISH 2
+
+void ipc_dispatcher(ipc_msg_t * ipc_msg)
+{
+	ipc_return((u64) ipc_msg);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret;
+	void *info_page_addr;
+	struct info_page *info_page;
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+	info_page = (struct info_page *)info_page_addr;
+
+	ret = ipc_register_server(ipc_dispatcher);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	if (info_page->args[ARG_RIVAL]) {
+		/* Another process owns "echo", the client checks our results */
+		info_page->args[ARG_PUBLISH] = ipc_publish("echo");
+		info_page->args[ARG_UNPUBLISH] = ipc_unpublish("echo");
+		ret = ipc_publish("rival");
+		fail_cond(ret < 0, "[IPC Server] publish failed %d\n", ret);
+	} else {
+		/* The client never gets our thread cap */
+		ret = ipc_publish("echo");
+		fail_cond(ret < 0, "[IPC Server] publish failed %d\n", ret);
+	}
+
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
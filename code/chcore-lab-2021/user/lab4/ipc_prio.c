@@ -0,0 +1,120 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+#include <lib/type.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+#define NO_AFF -1
+
+/* SERVER_HANDLER_THREADS of the library */
+#define HANDLER_NUM 4
+
+#define BLOCKER_PRIO 100
+#define LOW_PRIO 10
+#define HIGH_PRIO 200
+
+/* Shared with ipc_prio_server.c in the args of the info page */
+#define OP_BLOCK (1UL << 32)
+#define SHARED_BUSY 0
+#define SHARED_RELEASE 1
+#define SHARED_TICKET 2
+
+static ipc_struct_t client_ipc_struct;
+static volatile u64 done;
+static volatile s64 low_ticket = -1, high_ticket = -1;
+
+/* Keeps a handler of the server busy until released */
+static void *blocker_routine(void *arg)
+{
+	ipc_reg_call(&client_ipc_struct, OP_BLOCK | (u64) arg);
+	__atomic_fetch_add(&done, 1, __ATOMIC_SEQ_CST);
+	usys_exit(0);
+	return NULL;
+}
+
+static void *caller_routine(void *arg)
+{
+	volatile s64 *ticket = arg;
+
+	*ticket = ipc_reg_call(&client_ipc_struct, 0);
+	usys_exit(0);
+	return NULL;
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int info_pmo_cap;
+	int new_process_cap, new_thread_cap;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	volatile u64 *shared;
+	u64 i;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_ret ret %d\n", ret);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, CHILD_INFO_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)CHILD_INFO_VADDR;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 0;
+	shared = info_page->args;
+	shared[SHARED_BUSY] = 0;
+	shared[SHARED_RELEASE] = 0;
+	shared[SHARED_TICKET] = 0;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_prio_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+
+	ret = ipc_register_client(new_thread_cap, &client_ipc_struct);
+	fail_cond(ret < 0, "ipc_register_client failed\n");
+
+	/* Every handler of the server is busy */
+	for (i = 0; i < HANDLER_NUM; i++)
+		create_thread(blocker_routine, i, BLOCKER_PRIO, NO_AFF);
+	while (shared[SHARED_BUSY] != HANDLER_NUM)
+		usys_yield();
+
+	/* The low priority caller waits first */
+	create_thread(caller_routine, (u64) & low_ticket, LOW_PRIO, NO_AFF);
+	usys_sleep(20000);
+	create_thread(caller_routine, (u64) & high_ticket, HIGH_PRIO, NO_AFF);
+	usys_sleep(20000);
+
+	/* A single handler comes back, it goes to the high priority one */
+	shared[SHARED_RELEASE] = 1;
+	while (low_ticket < 0 || high_ticket < 0)
+		usys_yield();
+	fail_cond(high_ticket > low_ticket,
+		  "high priority served after low priority: %ld > %ld\n",
+		  high_ticket, low_ticket);
+
+	shared[SHARED_RELEASE] = HANDLER_NUM;
+	while (done != HANDLER_NUM)
+		usys_yield();
+
+	printf("[Client] high priority call served first\n");
+	info_page->exit_flag = 1;
+	return 0;
+}
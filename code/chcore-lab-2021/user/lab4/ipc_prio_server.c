@@ -0,0 +1,54 @@
+#include <lib/bug.h>
+#include <lib/ipc.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+/* See ipc_prio.c */
+#define OP_BLOCK (1UL << 32)
+#define SHARED_BUSY 0
+#define SHARED_RELEASE 1
+#define SHARED_TICKET 2
+
+static volatile u64 *shared;
+
+/* Calls get tickets in the order they are served */
+void ipc_dispatcher(ipc_msg_t * ipc_msg)
+{
+	u64 arg = (u64) ipc_msg;
+	u64 id = arg & ~OP_BLOCK;
+	u64 ticket;
+
+	ticket = __atomic_fetch_add(&shared[SHARED_TICKET], 1,
+				    __ATOMIC_SEQ_CST);
+	if (arg & OP_BLOCK) {
+		__atomic_fetch_add(&shared[SHARED_BUSY], 1, __ATOMIC_SEQ_CST);
+		while (shared[SHARED_RELEASE] <= id)
+			usys_yield();
+	}
+	ipc_return(ticket);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret;
+	void *info_page_addr;
+	struct info_page *info_page;
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+	info_page = (struct info_page *)info_page_addr;
+	shared = info_page->args;
+
+	ret = ipc_register_server(ipc_dispatcher);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
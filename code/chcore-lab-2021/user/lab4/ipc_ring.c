@@ -0,0 +1,110 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/errno.h>
+#include <lib/ipc.h>
+#include <lib/ipc_ring.h>
+#include <lib/print.h>
+#include <lib/proc.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+
+#define CHILD_INFO_VADDR 0xb0000000	/* 2M */
+
+#define REQ_NUM 10000
+#define BATCH 16
+
+/* Requests understood by ipc_ring_server.c */
+#define OP_ADD 1
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int info_pmo_cap;
+	int new_process_cap, new_thread_cap;
+	ipc_struct_t client_ipc_struct;
+	ipc_ring_client_t rc;
+	struct info_page *info_page;
+	struct pmo_map_request pmo_map_reqs[1];
+	struct ipc_ring_cqe cqes[IPC_RING_ENTRIES];
+	u64 args[IPC_RING_ARGS] = { 0 };
+	u64 submitted = 0, completed = 0, start, cycles;
+	int i, n;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	/* prepare the info_page (transfer init info) for the new process */
+	info_pmo_cap = usys_create_pmo(PAGE_SIZE, PMO_DATA);
+	fail_cond(info_pmo_cap < 0, "usys_create_ret ret %d\n", ret);
+
+	ret = usys_map_pmo(SELF_CAP, info_pmo_cap, CHILD_INFO_VADDR,
+			   VM_READ | VM_WRITE);
+	fail_cond(ret < 0, "usys_map_pmo ret %d\n", ret);
+
+	info_page = (void *)CHILD_INFO_VADDR;
+	info_page->ready_flag = 0;
+	info_page->exit_flag = 0;
+	info_page->nr_args = 0;
+
+	pmo_map_reqs[0].pmo_cap = info_pmo_cap;
+	pmo_map_reqs[0].addr = 0x100000000;
+	pmo_map_reqs[0].perm = VM_READ | VM_WRITE;
+
+	ret = spawn("/ipc_ring_server.bin", &new_process_cap, &new_thread_cap,
+		    pmo_map_reqs, 1, NULL, 0, 1);
+	fail_cond(ret < 0, "create_process returns %d\n", ret);
+
+	while (info_page->ready_flag != 1)
+		usys_yield();
+
+	ret = ipc_register_client(new_thread_cap, &client_ipc_struct);
+	fail_cond(ret < 0, "ipc_register_client failed\n");
+	ret = ipc_ring_connect(&rc, &client_ipc_struct);
+	fail_cond(ret < 0, "ipc_ring_connect ret %d\n", ret);
+
+	/* Keep the ring busy: submit in batches, reap whatever is done */
+	start = read_cycles();
+	while (completed < REQ_NUM) {
+		for (i = 0; i < BATCH && submitted < REQ_NUM; i++) {
+			args[0] = submitted;
+			args[1] = 1;
+			if (ipc_ring_submit(&rc, submitted, OP_ADD, args) < 0)
+				break;
+			submitted++;
+		}
+
+		n = ipc_ring_reap(&rc, cqes, IPC_RING_ENTRIES, true);
+		fail_cond(n < 0, "ipc_ring_reap ret %d\n", n);
+		for (i = 0; i < n; i++) {
+			fail_cond(cqes[i].tag != completed,
+				  "completion %ld has tag %ld\n", completed,
+				  cqes[i].tag);
+			fail_cond(cqes[i].ret != completed + 1,
+				  "request %ld returns %ld\n", completed,
+				  cqes[i].ret);
+			completed++;
+		}
+	}
+	cycles = read_cycles() - start;
+
+	printf("[Client] %d ring requests, %lu ns/request\n", REQ_NUM,
+	       cycles * 1000000000UL / read_freq() / REQ_NUM);
+
+	info_page->exit_flag = 1;
+	return 0;
+}
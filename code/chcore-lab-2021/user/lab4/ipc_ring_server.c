@@ -0,0 +1,76 @@
+#include <lib/bug.h>
+#include <lib/ipc.h>
+#include <lib/ipc_ring.h>
+#include <lib/launcher.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+#include <lib/type.h>
+
+#define PRIO 255
+#define NO_AFF -1
+#define MAX_RINGS 4
+
+/* Requests of the client, see ipc_ring.c */
+#define OP_ADD 1
+
+struct ring_worker {
+	u32 conn_cap;
+	struct ipc_ring *ring;
+};
+
+static struct ring_worker workers[MAX_RINGS];
+static int worker_num;
+
+static s64 ring_handler(struct ipc_ring_sqe *sqe)
+{
+	if (sqe->op != OP_ADD)
+		return -1;
+	return sqe->args[0] + sqe->args[1];
+}
+
+static void *ring_worker_routine(void *arg)
+{
+	struct ring_worker *worker = arg;
+
+	ipc_ring_serve(worker->conn_cap, worker->ring, ring_handler);
+	return NULL;
+}
+
+/* Every call sets up the ring of its connection */
+void ipc_dispatcher(ipc_msg_t * ipc_msg)
+{
+	struct ring_worker *worker;
+	int ret;
+
+	if (worker_num == MAX_RINGS)
+		ipc_return(-1);
+
+	worker = &workers[worker_num++];
+	worker->conn_cap = ipc_msg->server_conn_cap;
+	worker->ring = ipc_ring_of_msg(ipc_msg);
+	ret = create_thread(ring_worker_routine, (u64) worker, PRIO, NO_AFF);
+	ipc_return(ret < 0 ? ret : 0);
+}
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret;
+	void *info_page_addr;
+	struct info_page *info_page;
+
+	info_page_addr = (void *)(envp[0]);
+	fail_cond(info_page_addr == NULL, "[Server] no info received.\n");
+
+	ret = ipc_register_server(ipc_dispatcher);
+	fail_cond(ret < 0, "[IPC Server] register server failed\n", ret);
+
+	info_page = (struct info_page *)info_page_addr;
+	info_page->ready_flag = 1;
+
+	while (info_page->exit_flag != 1) {
+		usys_yield();
+	}
+
+	printf("[Server] exit\n");
+	return 0;
+}
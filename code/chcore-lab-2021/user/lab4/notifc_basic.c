@@ -0,0 +1,40 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/errno.h>
+#include <lib/spawn.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+#define NOTIFC_NUM 8
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int ret = 0;
+	int notifc_cap;
+	int i;
+
+	usys_fs_load_cpio(CPIO_BIN);
+
+	notifc_cap = usys_create_notifc();
+	fail_cond(notifc_cap < 0, "usys_create_notifc ret %d\n", notifc_cap);
+
+	/* Nothing signalled yet */
+	ret = usys_wait(notifc_cap, false, 0);
+	fail_cond(ret != -EAGAIN, "non-blocking usys_wait ret %d\n", ret);
+	ret = usys_wait(notifc_cap, true, 20000);
+	fail_cond(ret != -ETIME, "timed usys_wait ret %d\n", ret);
+
+	/* The child gets the notification cap as envp[1] */
+	printf("[Parent] create the notifier process.\n");
+	ret = spawn("/notifc_child.bin", NULL, NULL, NULL, 0, &notifc_cap, 1,
+		    1);
+	fail_cond(ret < 0, "spawn ret %d\n", ret);
+
+	for (i = 0; i < NOTIFC_NUM; i++) {
+		ret = usys_wait(notifc_cap, true, 0);
+		fail_cond(ret < 0, "usys_wait ret %d\n", ret);
+	}
+	printf("[Parent] received %d notifications.\n", NOTIFC_NUM);
+
+	return 0;
+}
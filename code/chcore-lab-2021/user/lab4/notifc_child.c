@@ -0,0 +1,25 @@
+#include <lib/bug.h>
+#include <lib/defs.h>
+#include <lib/syscall.h>
+#include <lib/type.h>
+
+#define NOTIFC_NUM 8
+
+int main(int argc, char *argv[], char *envp[])
+{
+	int notifc_cap;
+	int ret, i;
+
+	notifc_cap = (int)((u64) envp[1]);
+	printf("[Child] notifc_cap: %d\n", notifc_cap);
+
+	/* Signals sent before the parent waits are counted, not lost */
+	for (i = 0; i < NOTIFC_NUM; i++) {
+		ret = usys_notify(notifc_cap);
+		fail_cond(ret < 0, "usys_notify ret %d\n", ret);
+		if (i % 2)
+			usys_yield();
+	}
+	printf("[Child] Bye\n");
+	return 0;
+}
@@ -0,0 +1,37 @@
+#include <lib/print.h>
+#include <lib/syscall.h>
+#include <lib/thread.h>
+
+#define PRIO 255
+#define THREAD_NUM 3
+/* 100ms between two wakeups */
+#define SLEEP_STEP_US 100000
+
+void *thread_routine(void *arg)
+{
+	u64 thread_id = (u64) arg;
+
+	/* The last created thread sleeps the shortest and wakes up first */
+	usys_sleep((THREAD_NUM - thread_id) * SLEEP_STEP_US);
+	printf("Thread %lu wakes up, cpu %u\n", thread_id, usys_get_cpu_id());
+	usys_exit(0);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int child_thread_cap;
+	u64 thread_i;
+
+	for (thread_i = 0; thread_i < THREAD_NUM; ++thread_i) {
+		child_thread_cap =
+		    create_thread(thread_routine, thread_i, PRIO, 0);
+		if (child_thread_cap < 0)
+			printf("Create thread failed, return %d\n",
+			       child_thread_cap);
+	}
+
+	usys_sleep((THREAD_NUM + 1) * SLEEP_STEP_US);
+	printf("Main thread wakes up\n");
+	return 0;
+}
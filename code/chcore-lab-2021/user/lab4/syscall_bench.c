@@ -0,0 +1,56 @@
+#include <lib/print.h>
+#include <lib/syscall.h>
+
+#define WARMUP 1000
+#define ROUND 100000
+
+static inline u64 read_cycles(void)
+{
+	u64 cnt;
+
+	asm volatile ("isb\n mrs %0, cntpct_el0":"=r" (cnt)::"memory");
+	return cnt;
+}
+
+static inline u64 read_freq(void)
+{
+	u64 freq;
+
+	asm volatile ("mrs %0, cntfrq_el0":"=r" (freq));
+	return freq;
+}
+
+/* Average cost of one call in nanoseconds */
+static u64 cycles_to_ns(u64 cycles, u64 nr)
+{
+	return cycles * 1000000000UL / read_freq() / nr;
+}
+
+int main(int argc, char *argv[])
+{
+	u64 start, fast, slow;
+	int i;
+
+	for (i = 0; i < WARMUP; i++) {
+		usys_get_cpu_id();
+		usys_get_affinity(-1);
+	}
+
+	/* Leaf syscall taking the fast entry path */
+	start = read_cycles();
+	for (i = 0; i < ROUND; i++)
+		usys_get_cpu_id();
+	fast = read_cycles() - start;
+
+	/* Similar amount of work through the full entry path */
+	start = read_cycles();
+	for (i = 0; i < ROUND; i++)
+		usys_get_affinity(-1);
+	slow = read_cycles() - start;
+
+	printf("get_cpu_id (fast path): %lu ns/call\n",
+	       cycles_to_ns(fast, ROUND));
+	printf("get_affinity (full path): %lu ns/call\n",
+	       cycles_to_ns(slow, ROUND));
+	return 0;
+}
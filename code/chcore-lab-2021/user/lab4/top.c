@@ -0,0 +1,95 @@
+#include <lib/print.h>
+#include <lib/syscall.h>
+#include <lib/top.h>
+#include <lib/type.h>
+
+#define MAX_THREADS 64
+#define MAX_EVENTS 64
+/* Sampling interval */
+#define TOP_INTERVAL_US 500000
+#define TOP_ROUNDS 3
+
+static const char *type_str[] = {
+	"IDLE", "ROOT", "USER", "SHADOW", "KERNEL", "TESTS"
+};
+
+static const char *state_str[] = {
+	"INIT", "READY", "INTER", "RUNNING", "EXIT", "WAITING", "EXITING"
+};
+
+static const char *reason_str[] = { "vol", "invol", "exit" };
+
+struct top_thread_info threads[MAX_THREADS];
+struct top_thread_info last[MAX_THREADS];
+int nr_last = 0;
+struct sched_trace_event events[MAX_EVENTS * 4];
+
+/* Runtime of `info` in the previous sample, 0 if it is new */
+static u64 last_runtime(struct top_thread_info *info)
+{
+	int i;
+
+	for (i = 0; i < nr_last; i++)
+		if (last[i].thread == info->thread)
+			return last[i].runtime_us;
+	return 0;
+}
+
+static void print_threads(void)
+{
+	int nr, i;
+	u64 delta;
+
+	nr = usys_top_info(TOP_THREADS, threads, MAX_THREADS);
+	if (nr < 0) {
+		printf("usys_top_info ret %d\n", nr);
+		return;
+	}
+
+	printf("%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n", "THREAD", "TYPE",
+	       "STATE", "CPU", "CPU%", "RUN(us)", "SW(vol/invol)", "WAIT(us)",
+	       "MIG");
+	for (i = 0; i < nr; i++) {
+		delta = threads[i].runtime_us - last_runtime(&threads[i]);
+		printf("%lx\t%s\t%s\t%u\t%lu\t%lu\t%lu(%lu/%lu)\t%lu\t%lu\n",
+		       threads[i].thread, type_str[threads[i].type],
+		       state_str[threads[i].state], threads[i].cpuid,
+		       delta * 100 / TOP_INTERVAL_US, threads[i].runtime_us,
+		       threads[i].nr_switches, threads[i].nr_voluntary,
+		       threads[i].nr_involuntary, threads[i].wait_time_us,
+		       threads[i].nr_migrations);
+		last[i] = threads[i];
+	}
+	nr_last = nr;
+}
+
+static void print_trace(void)
+{
+	int nr, i;
+
+	nr = usys_top_info(TOP_TRACE, events, MAX_EVENTS * 4);
+	if (nr < 0) {
+		printf("usys_top_info ret %d\n", nr);
+		return;
+	}
+
+	/* Only the latest few events of the dump */
+	for (i = nr > 16 ? nr - 16 : 0; i < nr; i++)
+		printf("[%lu us] cpu %u %lx -> %lx %s\n", events[i].timestamp,
+		       events[i].cpuid, events[i].prev, events[i].next,
+		       reason_str[events[i].reason]);
+}
+
+int main(int argc, char *argv[])
+{
+	int round;
+
+	for (round = 0; round < TOP_ROUNDS; round++) {
+		usys_sleep(TOP_INTERVAL_US);
+		printf("----- top -----\n");
+		print_threads();
+	}
+	printf("----- switch trace -----\n");
+	print_trace();
+	return 0;
+}
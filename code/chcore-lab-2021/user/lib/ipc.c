@@ -1,8 +1,10 @@
 #include <lib/syscall.h>
 #include <lib/ipc.h>
 #include <lib/defs.h>
+#include <lib/errno.h>
 #include <lib/string.h>
 #include <lib/print.h>
+#include <lib/mutex.h>
 
 ipc_msg_t *ipc_create_msg(ipc_struct_t * icb, u64 data_len, u64 cap_slot_number)
 {
@@ -15,6 +17,7 @@ ipc_msg_t *ipc_create_msg(ipc_struct_t * icb, u64 data_len, u64 cap_slot_number)
 
 	ipc_msg->data_offset = sizeof(*ipc_msg);
 	ipc_msg->cap_slots_offset = ipc_msg->data_offset + data_len;
+	ipc_msg->grant_len = 0;
 	memset(ipc_get_msg_data(ipc_msg), 0, data_len);
 	for (i = 0; i < cap_slot_number; i++)
 		ipc_set_msg_cap(ipc_msg, i, -1);
@@ -56,6 +59,23 @@ int ipc_set_msg_cap(ipc_msg_t * ipc_msg, u64 cap_slot_index, u32 cap)
 	return 0;
 }
 
+int ipc_set_msg_grant(ipc_msg_t * ipc_msg, void *addr, u64 len, u64 perm)
+{
+	if ((u64) addr % PAGE_SIZE || len % PAGE_SIZE || len > IPC_GRANT_MAX)
+		return -1;
+	ipc_msg->grant_addr = (u64) addr;
+	ipc_msg->grant_len = len;
+	ipc_msg->grant_perm = perm;
+	return 0;
+}
+
+/* Valid in the server during the call only */
+void *ipc_get_msg_grant(ipc_msg_t * ipc_msg, u64 * len)
+{
+	*len = ipc_msg->grant_len;
+	return (void *)ipc_msg->grant_addr;
+}
+
 /* FIXME: currently ipc_msg is not dynamically allocated so that no need to free */
 int ipc_destroy_msg(ipc_msg_t * ipc_msg)
 {
@@ -68,18 +88,43 @@ int ipc_destroy_msg(ipc_msg_t * ipc_msg)
 #define SERVER_BUF_SIZE		0x1000
 #define CLIENT_BUF_BASE		0x7800000
 #define CLIENT_BUF_SIZE		0x1000
-#define MAX_CLIENT		16
+/* One grant window per handler thread */
+#define SERVER_GRANT_BASE	0x40000000
+/* Number of calls a server handles at the same time */
+#define SERVER_HANDLER_THREADS	4
 
-int ipc_register_server(server_handler server_handler)
+static int register_server(u64 callback, s32 cpu)
 {
 	struct ipc_vm_config vm_config = {
 		.stack_base_addr = SERVER_STACK_BASE,
 		.stack_size = SERVER_STACK_SIZE,
 		.buf_base_addr = SERVER_BUF_BASE,
 		.buf_size = SERVER_BUF_SIZE,
+		.grant_base_addr = SERVER_GRANT_BASE,
+		.grant_size = IPC_GRANT_MAX,
 	};
-	return usys_register_server((u64) server_handler, MAX_CLIENT,
-				    (u64) & vm_config);
+	return usys_register_server(callback, SERVER_HANDLER_THREADS,
+				    (u64) & vm_config, cpu);
+}
+
+int ipc_register_server(server_handler server_handler)
+{
+	return register_server((u64) server_handler, IPC_DISPATCH_CALLER);
+}
+
+int ipc_register_server_on(server_handler server_handler, s32 cpu)
+{
+	return register_server((u64) server_handler, cpu);
+}
+
+int ipc_register_fast_server(server_fast_handler server_handler)
+{
+	return register_server((u64) server_handler, IPC_DISPATCH_CALLER);
+}
+
+int ipc_register_fast_server_on(server_fast_handler server_handler, s32 cpu)
+{
+	return register_server((u64) server_handler, cpu);
 }
 
 int ipc_register_client(int server_thread_cap, ipc_struct_t * ipc_struct)
@@ -103,10 +148,100 @@ int ipc_register_client(int server_thread_cap, ipc_struct_t * ipc_struct)
 	return 0;
 }
 
+int ipc_close_client(ipc_struct_t * ipc_struct)
+{
+	return usys_ipc_close((u32) ipc_struct->conn_cap);
+}
+
+/* Buffers of the connections made by ipc_lookup */
+#define NAMED_BUF_BASE		0x7c00000
+#define NAMED_CONN_NUM		16
+
+/* Free when name is empty */
+static struct {
+	char name[IPC_NAME_LEN];
+	ipc_struct_t ipc_struct;
+} named_conns[NAMED_CONN_NUM];
+/* A zeroed mutex is unlocked */
+static struct mutex named_conns_lock;
+
+int ipc_publish(const char *name)
+{
+	return usys_ipc_publish(name, strlen(name));
+}
+
+int ipc_unpublish(const char *name)
+{
+	return usys_ipc_unpublish(name, strlen(name));
+}
+
+ipc_struct_t *ipc_lookup(const char *name)
+{
+	struct ipc_vm_config vm_config = { 0 };
+	ipc_struct_t *ipc_struct = NULL;
+	u64 len = strlen(name);
+	int i, slot = -1, conn_cap;
+
+	if (len == 0 || len >= IPC_NAME_LEN)
+		return NULL;
+
+	mutex_lock(&named_conns_lock);
+	for (i = 0; i < NAMED_CONN_NUM; i++) {
+		if (!named_conns[i].name[0]) {
+			if (slot < 0)
+				slot = i;
+		} else if (!strcmp(named_conns[i].name, name)) {
+			ipc_struct = &named_conns[i].ipc_struct;
+			goto out_unlock;
+		}
+	}
+	if (slot < 0)
+		goto out_unlock;
+
+	i = slot;
+	vm_config.buf_base_addr = NAMED_BUF_BASE + i * CLIENT_BUF_SIZE;
+	vm_config.buf_size = CLIENT_BUF_SIZE;
+	conn_cap = usys_ipc_lookup(name, len, (u64) & vm_config);
+	if (conn_cap < 0)
+		goto out_unlock;
+
+	memcpy(named_conns[i].name, name, len + 1);
+	ipc_struct = &named_conns[i].ipc_struct;
+	ipc_struct->conn_cap = conn_cap;
+	ipc_struct->shared_buf = vm_config.buf_base_addr;
+	ipc_struct->shared_buf_len = vm_config.buf_size;
+ out_unlock:
+	mutex_unlock(&named_conns_lock);
+	return ipc_struct;
+}
+
+/*
+ * A call failed with -ECAPBILITY: the server exited, which revoked the
+ * connection. If ipc_lookup made it, close it and free its entry, so the
+ * next lookup connects to whoever publishes the name now.
+ */
+static void ipc_forget(ipc_struct_t * icb)
+{
+	int i;
+
+	mutex_lock(&named_conns_lock);
+	for (i = 0; i < NAMED_CONN_NUM; i++) {
+		if (&named_conns[i].ipc_struct != icb || !named_conns[i].name[0])
+			continue;
+		/* Still busy with a call of another thread, retry next time */
+		if (usys_ipc_close((u32) icb->conn_cap) == 0)
+			named_conns[i].name[0] = '\0';
+		break;
+	}
+	mutex_unlock(&named_conns_lock);
+}
+
 int ipc_call(ipc_struct_t * icb, ipc_msg_t * ipc_msg)
 {
 	u64 ret = 0;
 	ret = usys_ipc_call(icb->conn_cap, (u64) ipc_msg);
+	if ((int)ret == -ECAPBILITY)
+		ipc_forget(icb);
 
 	return ret;
 }
@@ -115,6 +250,8 @@ int ipc_reg_call(ipc_struct_t * icb, u64 arg)
 {
 	u64 ret = 0;
 	ret = usys_ipc_reg_call(icb->conn_cap, (u64) arg);
+	if ((int)ret == -ECAPBILITY)
+		ipc_forget(icb);
 
 	return ret;
 }
@@ -123,3 +260,14 @@ void ipc_return(int ret)
 {
 	usys_ipc_return((u64) ret);
 }
+
+u64 ipc_fast_call(ipc_struct_t * icb, u64 * msg)
+{
+	usys_ipc_fast_call((u32) icb->conn_cap, msg);
+	return msg[0];
+}
+
+void ipc_fast_return(u64 * msg)
+{
+	usys_ipc_fast_return(msg);
+}
@@ -13,6 +13,10 @@ typedef struct ipc_msg {
 	u64 cap_slot_number;
 	u64 data_offset;
 	u64 cap_slots_offset;
+	/* Pages granted for the call, see ipc_set_msg_grant */
+	u64 grant_addr;
+	u64 grant_len;
+	u64 grant_perm;
 } ipc_msg_t;
 
 struct ipc_vm_config {
@@ -20,9 +24,13 @@ struct ipc_vm_config {
 	u64 stack_size;
 	u64 buf_base_addr;
 	u64 buf_size;
+	u64 grant_base_addr;
+	u64 grant_size;
 };
 
 int ipc_register_client(int server_thread_cap, ipc_struct_t * ipc_struct);
+/* Free the shared buffer, the connection cannot be used any more */
+int ipc_close_client(ipc_struct_t * ipc_struct);
 ipc_msg_t *ipc_create_msg(ipc_struct_t * icb, u64 data_len,
 			  u64 cap_slot_number);
 char *ipc_get_msg_data(ipc_msg_t * ipc_msg);
@@ -31,6 +39,16 @@ int ipc_set_msg_data(ipc_msg_t * ipc_msg, char *data, u64 offset, u64 len);
 int ipc_set_msg_cap(ipc_msg_t * ipc_msg, u64 cap_slot_index, u32 cap);
 int ipc_destroy_msg(ipc_msg_t * ipc_msg);
 
+/*
+ * Lend [addr, addr + len) (page aligned, up to IPC_GRANT_MAX bytes) to the
+ * server with perm (VM_READ and/or VM_WRITE) for the next call, without
+ * copy. The server finds the pages with ipc_get_msg_grant, they are gone
+ * from its address space once it returns.
+ */
+#define IPC_GRANT_MAX	0x1000000
+int ipc_set_msg_grant(ipc_msg_t * ipc_msg, void *addr, u64 len, u64 perm);
+void *ipc_get_msg_grant(ipc_msg_t * ipc_msg, u64 * len);
+
 int ipc_call(ipc_struct_t * icb, ipc_msg_t * ipc_msg);
 int ipc_reg_call(ipc_struct_t * icb, u64 arg);
 void ipc_return(int ret);
@@ -38,4 +56,40 @@ void ipc_return(int ret);
 typedef void (*server_handler) (ipc_msg_t * ipc_msg);
 int ipc_register_server(server_handler server_handler);
 
+/*
+ * Calls run on the CPU of the caller with ipc_register_server. The _on
+ * variants run them all on `cpu`, calls from other CPUs are handed over
+ * to it: the server keeps its cache warm there, while the callers pay
+ * for a cross-CPU round trip.
+ */
+#define IPC_DISPATCH_CALLER (-1)
+int ipc_register_server_on(server_handler server_handler, s32 cpu);
+
+/*
+ * Register IPC: up to IPC_FAST_MSG_REGS words each way, without the shared
+ * buffer. The handler of the server gets them as its arguments and
+ * replies with ipc_fast_return. The first word of the reply is returned.
+ */
+#define IPC_FAST_MSG_REGS 8
+typedef void (*server_fast_handler) (u64, u64, u64, u64, u64, u64, u64, u64);
+int ipc_register_fast_server(server_fast_handler server_handler);
+int ipc_register_fast_server_on(server_fast_handler server_handler, s32 cpu);
+u64 ipc_fast_call(ipc_struct_t * icb, u64 * msg);
+void ipc_fast_return(u64 * msg);
+
+/*
+ * Name service. A server thread that registered publishes itself with
+ * ipc_publish. Clients call ipc_lookup, which connects once per process
+ * and gives every thread the same ipc_struct. Register and fast calls on
+ * it can be made from several threads at once; messages share its
+ * buffer, so their callers must take turns. When the server exits, its
+ * connections are revoked: ipc_call and ipc_reg_call return -ECAPBILITY
+ * and the next ipc_lookup of the name connects again.
+ */
+#define IPC_NAME_LEN	32
+int ipc_publish(const char *name);
+/* Names are also withdrawn when their server thread exits */
+int ipc_unpublish(const char *name);
+ipc_struct_t *ipc_lookup(const char *name);
+
 #define INFO_PAGE_VADDR ((void *)0x100000ll)
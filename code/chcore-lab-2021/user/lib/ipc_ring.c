@@ -0,0 +1,149 @@
+#include <lib/errno.h>
+#include <lib/ipc_ring.h>
+#include <lib/string.h>
+#include <lib/syscall.h>
+
+#define IPC_RING_MASK (IPC_RING_ENTRIES - 1)
+
+#define load_acquire(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define store_release(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+/*
+ * Each end publishes its index, then checks whether the other end has
+ * seen everything before; the full barrier in between makes sure one of
+ * the two ends sees the other's update, so no wakeup is lost.
+ */
+#define full_barrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/*
+ * Set up the ring in the shared buffer and tell the server about it with
+ * a synchronous call carrying no data. Returns the reply of the server.
+ */
+int ipc_ring_connect(ipc_ring_client_t * rc, ipc_struct_t * icb)
+{
+	ipc_msg_t *ipc_msg;
+
+	if (icb->shared_buf_len < IPC_RING_OFFSET + sizeof(struct ipc_ring))
+		return -EINVAL;
+
+	rc->icb = icb;
+	rc->ring = (struct ipc_ring *)(icb->shared_buf + IPC_RING_OFFSET);
+	rc->sq_tail = 0;
+	memset(rc->ring, 0, sizeof(struct ipc_ring));
+
+	ipc_msg = ipc_create_msg(icb, 0, 0);
+	return ipc_call(icb, ipc_msg);
+}
+
+/*
+ * Queue a request, it is only visible to the server after
+ * ipc_ring_flush. Fails with -EAGAIN when IPC_RING_ENTRIES requests are
+ * in flight, which also keeps the completion ring from overflowing.
+ */
+int ipc_ring_submit(ipc_ring_client_t * rc, u64 tag, u64 op, u64 * args)
+{
+	struct ipc_ring *ring = rc->ring;
+	struct ipc_ring_sqe *sqe;
+
+	if (rc->sq_tail - ring->cq_head >= IPC_RING_ENTRIES)
+		return -EAGAIN;
+
+	sqe = &ring->sq[rc->sq_tail & IPC_RING_MASK];
+	sqe->tag = tag;
+	sqe->op = op;
+	if (args)
+		memcpy(sqe->args, args, sizeof(sqe->args));
+	rc->sq_tail++;
+	return 0;
+}
+
+/* Publish the queued requests, waking the server if it saw none */
+int ipc_ring_flush(ipc_ring_client_t * rc)
+{
+	struct ipc_ring *ring = rc->ring;
+	u32 old_tail = ring->sq_tail;
+
+	if (rc->sq_tail == old_tail)
+		return 0;
+
+	store_release(&ring->sq_tail, rc->sq_tail);
+	full_barrier();
+	if (load_acquire(&ring->sq_head) == old_tail)
+		return usys_ipc_notify(rc->icb->conn_cap);
+	return 0;
+}
+
+/*
+ * Flush, then take up to `max` completions. Returns how many, 0 if there
+ * is none and !is_block, or an error of the wait.
+ */
+int ipc_ring_reap(ipc_ring_client_t * rc, struct ipc_ring_cqe *cqes, int max,
+		  bool is_block)
+{
+	struct ipc_ring *ring = rc->ring;
+	u32 head, tail;
+	int n, ret;
+
+	ret = ipc_ring_flush(rc);
+	if (ret < 0)
+		return ret;
+
+	for (;;) {
+		head = ring->cq_head;
+		tail = load_acquire(&ring->cq_tail);
+		if (head != tail)
+			break;
+		if (!is_block)
+			return 0;
+		ret = usys_ipc_wait(rc->icb->conn_cap, true, 0);
+		if (ret < 0)
+			return ret;
+	}
+
+	for (n = 0; n < max && head != tail; n++, head++)
+		cqes[n] = ring->cq[head & IPC_RING_MASK];
+	store_release(&ring->cq_head, head);
+	full_barrier();
+	return n;
+}
+
+struct ipc_ring *ipc_ring_of_msg(ipc_msg_t * ipc_msg)
+{
+	return (struct ipc_ring *)((char *)ipc_msg + IPC_RING_OFFSET);
+}
+
+/*
+ * Server loop, usually in a thread of its own: handle all the published
+ * requests, publish their completions at once and sleep when the
+ * submission ring is empty. Never returns unless the connection goes away.
+ */
+void ipc_ring_serve(u32 conn_cap, struct ipc_ring *ring,
+		    ipc_ring_handler handler)
+{
+	struct ipc_ring_sqe *sqe;
+	struct ipc_ring_cqe *cqe;
+	u32 head, tail, cq_tail, old_cq_tail;
+
+	for (;;) {
+		head = ring->sq_head;
+		tail = load_acquire(&ring->sq_tail);
+		if (head == tail) {
+			if (usys_ipc_wait(conn_cap, true, 0) < 0)
+				return;
+			continue;
+		}
+
+		old_cq_tail = cq_tail = ring->cq_tail;
+		for (; head != tail; head++, cq_tail++) {
+			sqe = &ring->sq[head & IPC_RING_MASK];
+			cqe = &ring->cq[cq_tail & IPC_RING_MASK];
+			cqe->tag = sqe->tag;
+			cqe->ret = handler(sqe);
+		}
+
+		store_release(&ring->sq_head, head);
+		store_release(&ring->cq_tail, cq_tail);
+		full_barrier();
+		if (load_acquire(&ring->cq_head) == old_cq_tail)
+			usys_ipc_notify(conn_cap);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <lib/ipc.h>
+#include <lib/type.h>
+
+/*
+ * Asynchronous IPC over the shared buffer of a connection, in the manner
+ * of io_uring: the client posts requests to the submission ring, a server
+ * thread drains them in batches and posts the results to the completion
+ * ring. Each end signals the other (usys_ipc_notify) only when a ring it
+ * fills goes from empty to non-empty.
+ */
+#define IPC_RING_ENTRIES	32	/* power of two */
+#define IPC_RING_ARGS		4
+/* The ring follows the ipc_msg of the call setting it up */
+#define IPC_RING_OFFSET		256
+
+struct ipc_ring_sqe {
+	u64 tag;
+	u64 op;
+	u64 args[IPC_RING_ARGS];
+};
+
+struct ipc_ring_cqe {
+	u64 tag;
+	s64 ret;
+};
+
+/* Each index is written by one end only and has its own cache line */
+struct ipc_ring {
+	u32 sq_head;		/* server */
+	char pad0[60];
+	u32 sq_tail;		/* client */
+	char pad1[60];
+	u32 cq_head;		/* client */
+	char pad2[60];
+	u32 cq_tail;		/* server */
+	char pad3[60];
+	struct ipc_ring_sqe sq[IPC_RING_ENTRIES];
+	struct ipc_ring_cqe cq[IPC_RING_ENTRIES];
+};
+
+/* Client end, with the submissions not published yet */
+typedef struct ipc_ring_client {
+	ipc_struct_t *icb;
+	struct ipc_ring *ring;
+	u32 sq_tail;
+} ipc_ring_client_t;
+
+int ipc_ring_connect(ipc_ring_client_t * rc, ipc_struct_t * icb);
+int ipc_ring_submit(ipc_ring_client_t * rc, u64 tag, u64 op, u64 * args);
+int ipc_ring_flush(ipc_ring_client_t * rc);
+int ipc_ring_reap(ipc_ring_client_t * rc, struct ipc_ring_cqe *cqes, int max,
+		  bool is_block);
+
+/* Server end */
+typedef s64(*ipc_ring_handler) (struct ipc_ring_sqe * sqe);
+struct ipc_ring *ipc_ring_of_msg(ipc_msg_t * ipc_msg);
+void ipc_ring_serve(u32 conn_cap, struct ipc_ring *ring,
+		    ipc_ring_handler handler);
@@ -0,0 +1,64 @@
+#include <lib/mutex.h>
+#include <lib/syscall.h>
+
+static inline u32 cmpxchg_32(volatile u32 *ptr, u32 compare, u32 exchange)
+{
+	u32 oldval, ret;
+
+	asm volatile ("1: ldaxr   %w0, %2\n"
+		      "   cmp     %w0, %w3\n"
+		      "   b.ne    2f\n"
+		      "   stlxr   %w1, %w4, %2\n"
+		      "   cbnz    %w1, 1b\n"
+		      "2:":"=&r" (oldval), "=&r"(ret), "+Q"(*ptr)
+		      :"r"(compare), "r"(exchange)
+		      :"cc", "memory");
+	return oldval;
+}
+
+static inline u32 xchg_32(volatile u32 *ptr, u32 exchange)
+{
+	u32 oldval, ret;
+
+	asm volatile ("1: ldaxr   %w0, %2\n"
+		      "   stlxr   %w1, %w3, %2\n"
+		      "   cbnz    %w1, 1b\n"
+		      :"=&r" (oldval), "=&r"(ret), "+Q"(*ptr)
+		      :"r"(exchange)
+		      :"memory");
+	return oldval;
+}
+
+void mutex_init(struct mutex *mutex)
+{
+	mutex->state = 0;
+}
+
+int mutex_try_lock(struct mutex *mutex)
+{
+	return cmpxchg_32(&mutex->state, 0, 1) == 0 ? 0 : -1;
+}
+
+void mutex_lock(struct mutex *mutex)
+{
+	u32 state;
+
+	state = cmpxchg_32(&mutex->state, 0, 1);
+	if (state == 0)
+		return;
+
+	/* Mark the mutex contended and sleep until the owner wakes us */
+	if (state != 2)
+		state = xchg_32(&mutex->state, 2);
+	while (state != 0) {
+		usys_futex_wait((u32 *)&mutex->state, 2, 0);
+		state = xchg_32(&mutex->state, 2);
+	}
+}
+
+void mutex_unlock(struct mutex *mutex)
+{
+	/* Only enter the kernel if someone may be waiting */
+	if (xchg_32(&mutex->state, 0) == 2)
+		usys_futex_wake((u32 *)&mutex->state, 1);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <lib/type.h>
+
+/*
+ * Futex based mutex: only the contended paths enter the kernel.
+ * state: 0 unlocked, 1 locked, 2 locked with (possible) waiters
+ */
+struct mutex {
+	volatile u32 state;
+};
+
+void mutex_init(struct mutex *mutex);
+void mutex_lock(struct mutex *mutex);
+int mutex_try_lock(struct mutex *mutex);
+void mutex_unlock(struct mutex *mutex);
@@ -75,6 +75,11 @@ u64 usys_yield(void)
 	return syscall(SYS_yield, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
+int usys_sleep(u64 us)
+{
+	return syscall(SYS_sleep, us, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
 int usys_create_device_pmo(u64 paddr, u64 size)
 {
 	return syscall(SYS_create_device_pmo, paddr, size, 0, 0, 0, 0, 0, 0, 0);
@@ -97,6 +102,72 @@ s32 usys_get_affinity(u64 thread_cap)
 	return syscall(SYS_get_affinity, thread_cap, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
+int usys_set_time_slice(u64 thread_cap, u64 slice_us)
+{
+	return syscall(SYS_set_time_slice, thread_cap, slice_us, 0, 0, 0, 0, 0,
+		       0, 0);
+}
+
+int usys_futex_wait(u32 *uaddr, u32 val, u64 timeout_us)
+{
+	return syscall(SYS_futex_wait, (u64) uaddr, val, timeout_us, 0, 0, 0,
+		       0, 0, 0);
+}
+
+int usys_futex_wake(u32 *uaddr, u32 nr_wake)
+{
+	return syscall(SYS_futex_wake, (u64) uaddr, nr_wake, 0, 0, 0, 0, 0, 0,
+		       0);
+}
+
+int usys_create_notifc(void)
+{
+	return syscall(SYS_create_notifc, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+int usys_wait(u32 notifc_cap, bool is_block, u64 timeout_us)
+{
+	return syscall(SYS_wait, notifc_cap, is_block, timeout_us, 0, 0, 0, 0,
+		       0, 0);
+}
+
+int usys_notify(u32 notifc_cap)
+{
+	return syscall(SYS_notify, notifc_cap, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+int usys_ipc_notify(u32 conn_cap)
+{
+	return syscall(SYS_ipc_notify, conn_cap, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+int usys_ipc_wait(u32 conn_cap, bool is_block, u64 timeout_us)
+{
+	return syscall(SYS_ipc_wait, conn_cap, is_block, timeout_us, 0, 0, 0,
+		       0, 0, 0);
+}
+
+int usys_ipc_close(u32 conn_cap)
+{
+	return syscall(SYS_ipc_close, conn_cap, 0, 0, 0, 0, 0, 0, 0, 0);
+}
+
+int usys_ipc_publish(const char *name, u64 len)
+{
+	return syscall(SYS_ipc_publish, (u64) name, len, 0, 0, 0, 0, 0, 0, 0);
+}
+
+int usys_ipc_lookup(const char *name, u64 len, u64 vm_config_ptr)
+{
+	return syscall(SYS_ipc_lookup, (u64) name, len, vm_config_ptr, 0, 0, 0,
+		       0, 0, 0);
+}
+
+int usys_ipc_unpublish(const char *name, u64 len)
+{
+	return syscall(SYS_ipc_unpublish, (u64) name, len, 0, 0, 0, 0, 0, 0, 0);
+}
+
 /*
  * Lab4 - exercise 9
  * Add syscall
@@ -119,10 +190,11 @@ int usys_create_process(void)
 	return syscall(SYS_create_process, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
-u64 usys_register_server(u64 callback, u64 max_client, u64 vm_config_ptr)
+u64 usys_register_server(u64 callback, u64 handler_num, u64 vm_config_ptr,
+			 s32 dispatch_cpu)
 {
-	return syscall(SYS_register_server, callback, max_client, vm_config_ptr,
-		       0, 0, 0, 0, 0, 0);
+	return syscall(SYS_register_server, callback, handler_num, vm_config_ptr,
+		       dispatch_cpu, 0, 0, 0, 0, 0);
 }
 
 u32 usys_register_client(u32 server_cap, u64 vm_config_ptr)
@@ -146,6 +218,63 @@ void usys_ipc_return(u64 ret)
 	syscall(SYS_ipc_return, ret, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
+/*
+ * Register IPC: msg[0-7] travel in x0-x7 and the reply comes back there.
+ * The connection cap is in the upper half of x8. The kernel does not
+ * preserve x9-x18 on this path.
+ */
+#define IPC_FAST_CLOBBERS "x9", "x10", "x11", "x12", "x13", "x14", "x15", \
+	"x16", "x17", "x18", "memory"
+
+void usys_ipc_fast_call(u32 conn_cap, u64 *msg)
+{
+	register u64 x0 asm("x0") = msg[0];
+	register u64 x1 asm("x1") = msg[1];
+	register u64 x2 asm("x2") = msg[2];
+	register u64 x3 asm("x3") = msg[3];
+	register u64 x4 asm("x4") = msg[4];
+	register u64 x5 asm("x5") = msg[5];
+	register u64 x6 asm("x6") = msg[6];
+	register u64 x7 asm("x7") = msg[7];
+	register u64 x8 asm("x8") = ((u64)conn_cap << 32) | SYS_ipc_fast_call;
+
+	asm volatile("svc #0"
+		     : "+r" (x0), "+r" (x1), "+r" (x2), "+r" (x3),
+		       "+r" (x4), "+r" (x5), "+r" (x6), "+r" (x7), "+r" (x8)
+		     :
+		     : IPC_FAST_CLOBBERS);
+
+	msg[0] = x0;
+	msg[1] = x1;
+	msg[2] = x2;
+	msg[3] = x3;
+	msg[4] = x4;
+	msg[5] = x5;
+	msg[6] = x6;
+	msg[7] = x7;
+}
+
+/* Does not return unless the thread is not serving a call */
+void usys_ipc_fast_return(u64 *msg)
+{
+	register u64 x0 asm("x0") = msg[0];
+	register u64 x1 asm("x1") = msg[1];
+	register u64 x2 asm("x2") = msg[2];
+	register u64 x3 asm("x3") = msg[3];
+	register u64 x4 asm("x4") = msg[4];
+	register u64 x5 asm("x5") = msg[5];
+	register u64 x6 asm("x6") = msg[6];
+	register u64 x7 asm("x7") = msg[7];
+	register u64 x8 asm("x8") = SYS_ipc_fast_return;
+
+	asm volatile("svc #0"
+		     : "+r" (x0), "+r" (x1), "+r" (x2), "+r" (x3),
+		       "+r" (x4), "+r" (x5), "+r" (x6), "+r" (x7), "+r" (x8)
+		     :
+		     : IPC_FAST_CLOBBERS);
+	msg[0] = x0;
+}
+
 int usys_debug(void)
 {
 	return syscall(SYS_debug, 0, 0, 0, 0, 0, 0, 0, 0, 0);
@@ -200,3 +329,8 @@ void usys_top(void)
 {
 	syscall(SYS_top, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 }
+
+int usys_top_info(u64 cmd, void *buf, u64 nr)
+{
+	return syscall(SYS_top, cmd, (u64) buf, nr, 0, 0, 0, 0, 0, 0);
+}
@@ -22,10 +22,24 @@
 #define SYS_set_affinity                        18
 #define SYS_get_affinity                        19
 #define SYS_create_device_pmo			20
+#define SYS_set_time_slice			21
+#define SYS_futex_wait				22
+#define SYS_futex_wake				23
+#define SYS_create_notifc			24
+#define SYS_wait				25
+#define SYS_notify				26
+#define SYS_ipc_notify				27
+#define SYS_ipc_wait				28
+#define SYS_ipc_close				29
+#define SYS_ipc_publish				30
+#define SYS_ipc_lookup				31
+#define SYS_ipc_unpublish			32
 
 /* Lab4 specfic */
 #define SYS_get_cpu_id                          50
 #define SYS_ipc_reg_call                        51
+#define SYS_ipc_fast_call                       52
+#define SYS_ipc_fast_return                     53
 
 #define SYS_create_pmos                         101
 #define SYS_map_pmos                            102
@@ -51,21 +65,37 @@ u64 usys_handle_brk(u64 addr);
 
 u32 usys_getc(void);
 u64 usys_yield(void);
+int usys_sleep(u64 us);
 int usys_create_device_pmo(u64 paddr, u64 size);
 int usys_create_thread(u64 process_cap, u64 stack, u64 pc, u64 arg, u32 prio,
 		       s32 cpuid);
 int usys_create_process(void);
-u64 usys_register_server(u64 callback, u64 max_client, u64 vm_config_ptr);
+u64 usys_register_server(u64 callback, u64 handler_num, u64 vm_config_ptr,
+			 s32 dispatch_cpu);
 u32 usys_register_client(u32 server_cap, u64 vm_config_ptr);
 u64 usys_ipc_call(u32 conn_cap, u64 arg0);
 u64 usys_ipc_reg_call(u32 conn_cap, u64 arg0);
 void usys_ipc_return(u64 ret);
+void usys_ipc_fast_call(u32 conn_cap, u64 *msg);
+void usys_ipc_fast_return(u64 *msg);
 int usys_debug(void);
 int usys_cap_copy_to(u64 dest_process_cap, u64 src_slot_id);
 int usys_cap_copy_from(u64 src_process_cap, u64 src_slot_id);
 int usys_unmap_pmo(u64 process_cap, u64 pmo_cap, u64 addr);
 int usys_set_affinity(u64 thread_cap, s32 aff);
 s32 usys_get_affinity(u64 thread_cap);
+int usys_set_time_slice(u64 thread_cap, u64 slice_us);
+int usys_futex_wait(u32 *uaddr, u32 val, u64 timeout_us);
+int usys_futex_wake(u32 *uaddr, u32 nr_wake);
+int usys_create_notifc(void);
+int usys_wait(u32 notifc_cap, bool is_block, u64 timeout_us);
+int usys_notify(u32 notifc_cap);
+int usys_ipc_notify(u32 conn_cap);
+int usys_ipc_wait(u32 conn_cap, bool is_block, u64 timeout_us);
+int usys_ipc_close(u32 conn_cap);
+int usys_ipc_publish(const char *name, u64 len);
+int usys_ipc_lookup(const char *name, u64 len, u64 vm_config_ptr);
+int usys_ipc_unpublish(const char *name, u64 len);
 u32 usys_get_cpu_id(void);
 
 int usys_create_pmos(void *, u64);
@@ -75,3 +105,4 @@ int usys_read_pmo(u64 cap, u64 offset, void *buf, u64 size);
 int usys_transfer_caps(u64, int *, int, int *);
 
 void usys_top(void);
+int usys_top_info(u64 cmd, void *buf, u64 nr);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <lib/type.h>
+
+/* Keep in sync with kernel/sched/stat.h */
+
+/* Commands of usys_top_info */
+#define TOP_PRINT	0
+#define TOP_THREADS	1
+#define TOP_TRACE	2
+
+struct top_thread_info {
+	u64 thread;
+	u32 type;
+	u32 state;
+	u32 prio;
+	u32 cpuid;
+	u64 runtime_us;
+	u64 nr_switches;
+	u64 nr_voluntary;
+	u64 nr_involuntary;
+	u64 wait_time_us;
+	u64 nr_migrations;
+};
+
+enum sched_switch_reason {
+	SWITCH_VOLUNTARY = 0,
+	SWITCH_INVOLUNTARY,
+	SWITCH_EXIT,
+};
+
+struct sched_trace_event {
+	u64 timestamp;
+	u64 prev;
+	u64 next;
+	u32 cpuid;
+	u32 reason;
+};